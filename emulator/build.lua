@@ -34,12 +34,49 @@ local function fs_copy(source,dest)
 end
 
 -- build flags --------------------------------------------------------------@/
+local function make_options()
+	local opts = {}
+	if argsearch('nohistory') then
+		table.insert(opts,"NOHISTORY=1")
+	end
+	if argsearch('lazyflags') then
+		table.insert(opts,"LAZYFLAGS=1")
+	end
+	if argsearch('threaded') then
+		table.insert(opts,"CPUCORE=threaded")
+	elseif argsearch('cached') or argsearch('jit') then
+		table.insert(opts,"CPUCORE=cached")
+	end
+	if argsearch('jit') then
+		table.insert(opts,"JIT=1")
+	end
+	if argsearch('noidleskip') then
+		table.insert(opts,"NOIDLESKIP=1")
+	end
+	if argsearch('checked') then
+		table.insert(opts,"CHECKED=1")
+	end
+	if argsearch('profile') then
+		table.insert(opts,"PROFILE=1")
+	end
+	if argsearch('trace') then
+		table.insert(opts,"TRACE=1")
+	end
+	if argsearch('gdb') then
+		table.insert(opts,"GDB=1")
+	end
+	if argsearch('pputhread') then
+		table.insert(opts,"PPUTHREAD=1")
+	end
+	return table.concat(opts," ")
+end
+
 local function compile()
 	execa("rm -rf bin\\fern.exe")
 	if argsearch('singlejob') then
-		execa("make all -j1")
+		execa("make all -j1",make_options())
 	else
-		execa("make all -j6")
+		execa("make all -j6",make_options())
 	end
 end
 
@@ -3,12 +3,18 @@
 
 #include <array>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
-#include <deque>
 #include <vector>
-#include <stack>
 #include <string>
 #include <optional>
+#include <variant>
+#include <unordered_map>
 
 #include <blob.h>
 
@@ -31,6 +37,37 @@ namespace fern {
 	constexpr int KBSIZE(int n) { return 1024 * n; }
 	constexpr int MBSIZE(int n) { return KBSIZE(1024) * n; }
 
+	// hot path array access. FERN_CHECKED builds bounds check everything
+	// with at(), so bad indexes stop the emulator. otherwise, masked_at()
+	// masks the index to the (power of 2) size so it's always in range,
+	// and checked_at() is for indexes the caller's already range checked.
+	template<typename T,size_t N>
+	constexpr auto masked_at(std::array<T,N>& arr,size_t index) -> T& {
+		static_assert((N & (N-1)) == 0,"masked_at() needs a power of 2 size");
+#ifdef FERN_CHECKED
+		return arr.at(index);
+#else
+		return arr[index & (N-1)];
+#endif
+	}
+	template<typename T,size_t N>
+	constexpr auto masked_at(const std::array<T,N>& arr,size_t index) -> const T& {
+		static_assert((N & (N-1)) == 0,"masked_at() needs a power of 2 size");
+#ifdef FERN_CHECKED
+		return arr.at(index);
+#else
+		return arr[index & (N-1)];
+#endif
+	}
+	template<typename T,size_t N>
+	constexpr auto checked_at(std::array<T,N>& arr,size_t index) -> T& {
+#ifdef FERN_CHECKED
+		return arr.at(index);
+#else
+		return arr[index];
+#endif
+	}
+
 	namespace RFlagMapAttrib {
 		constexpr auto bank(int attr) -> int { return (attr>>3)&1; }
 		constexpr auto flipX(int attr) -> int { return (attr>>5)&1; }
@@ -75,13 +112,15 @@ namespace fern {
 		};
 	}
 
+	// in JOYP order: directions in the low nibble of the packed joypad
+	// state, buttons in the high one.
 	namespace EmuButton {
 		enum {
+			right,
+			left,
 			up,
 			down,
-			left,
-			right,
-			a,b,start,select,
+			a,b,select,start,
 			num_keys
 		};
 	}
@@ -131,7 +170,14 @@ namespace fern {
 			auto render_toSurface(SDL_Surface* surface) -> void;
 
 			auto clear(CColor color) -> void;
-			auto dot_set(int x, int y, CColor color) -> void;
+			// callers keep x & y on screen, only checked with FERN_CHECKED
+			auto dot_set(int x, int y, CColor color) -> void {
+#ifdef FERN_CHECKED
+				dot_check(x,y);
+#endif
+				dot_access(x,y) = color;
+			}
+			auto dot_check(int x, int y) -> void;
 			constexpr auto dot_access(int x, int y) -> CColor& {
 				return m_bmp[x + y * width()];
 			}
@@ -141,10 +187,40 @@ namespace fern {
 			constexpr auto height() const -> int { return m_height; }
 			constexpr auto dimensions() const -> int { return width() * height(); }
 	};
+	// what a line's drawn from: the PPU registers, and the memory it reads.
+	// line_input() points it at CMem's.
+	struct CLineInput {
+		int lcdc;
+		int scx,scy;
+		int wx,wy;
+		int bgp;
+		std::array<int,2> obp;
+		const std::array<uint8_t,2 * KBSIZE(8)>* vram;
+		const std::array<uint8_t,160>* oam;
+		const std::array<uint8_t,64>* paletBG;
+		const std::array<uint8_t,64>* paletObj;
+	};
+#ifdef FERN_PPU_THREAD
+	// a line queued for the PPU worker. vram only has the pages written since
+	// the line before (vram_dirty), everything else is copied every line.
+	struct CLineJob {
+		int draw_y;
+		CLineInput input; // registers only, the worker fills in the pointers
+		uint64_t vram_dirty; // 256 byte pages
+		std::array<uint8_t,160> oam;
+		std::array<uint8_t,64> paletBG;
+		std::array<uint8_t,64> paletObj;
+		std::array<uint8_t,2 * KBSIZE(8)> vram;
+	};
+#endif
 	class CRenderer : public CEmulatorComponent {
 		public:
 			static const std::array<CColor,4> MONOPALET_GRAY;
 			static const std::array<CColor,4> MONOPALET_ORANGE;
+#ifdef FERN_PPU_THREAD
+			static constexpr uint32_t PPU_RING_SIZE = 32; // lines
+			static constexpr uint32_t PPU_WAKE_LINES = 8; // queued before the worker's woken
+#endif
 		private:
 			SDL_Window* m_window;
 			SDL_Window* m_windowVRAM;
@@ -157,6 +233,26 @@ namespace fern {
 			std::array<int,0x400> m_vramMarker;
 			int m_timeLastFrame;
 			bool m_vsyncEnabled;
+#ifdef FERN_PPU_THREAD
+			// single producer/single consumer ring of lines, from the
+			// emulation thread to the PPU worker. the mutex is only taken
+			// by whichever side has to sleep (m_ppuIdle/m_ppuWaiting).
+			std::vector<CLineJob> m_ppuRing;
+			std::array<uint8_t,2 * KBSIZE(8)> m_ppuVRAM; // worker's copy
+			std::atomic<uint32_t> m_ppuHead; // lines queued
+			std::atomic<uint32_t> m_ppuTail; // lines drawn
+			std::atomic<bool> m_ppuIdle; // worker's asleep
+			std::atomic<bool> m_ppuWaiting; // emulation thread's asleep
+			bool m_ppuStopping;
+			std::thread m_ppuThread;
+			std::mutex m_ppuMutex;
+			std::condition_variable m_ppuCond;
+
+			auto ppu_start() -> void;
+			auto ppu_stop() -> void;
+			auto ppu_wait(uint32_t pending) -> void;
+			auto ppu_thread() -> void;
+#endif
 		public:
 			CRenderer();
 			~CRenderer();
@@ -167,34 +263,47 @@ namespace fern {
 			auto render_vramwindow() -> void;
 			auto render_palwindow() -> void;
 			auto present() -> void;
+			auto flip() -> void;
+			auto line_input() -> CLineInput;
+#ifdef FERN_PPU_THREAD
+			// queues the line for the PPU worker, with what it reads as it is now
+			auto draw_line(int draw_y) -> void { ppu_queue(draw_y); }
+			auto ppu_queue(int draw_y) -> void;
+			// waits for the worker to draw everything that's queued
+			auto ppu_sync() -> void;
+#else
 			auto draw_line(int draw_y) -> void;
-			auto draw_lineDMG(int draw_y) -> void;
-			auto draw_lineCGB(int draw_y) -> void;
+			auto ppu_sync() -> void {}
+#endif
+			auto draw_lineDMG(int draw_y,const CLineInput& in) -> void;
+			auto draw_lineCGB(int draw_y,const CLineInput& in) -> void;
 
 			constexpr auto vsync_set(bool enable) -> void { m_vsyncEnabled = enable; }
 			constexpr auto vsync_enabled() const -> bool { return m_vsyncEnabled; }
 	};
 
 	// mapper -------------------------------------------@/
+	// mappers aren't virtual: CMem keeps whichever one the ROM uses in a
+	// CMapperAny, picked once by load_romfile(). each one has:
+	//	name(), read_sram(), write_sram(), write_rom(), sram_serialize()
+	//	rom_bank(): bank at $4000-$7FFF. CMem latches this after every
+	//	ROM write, so ROM reads don't go through the mapper at all.
+	//	sram_bank(): 8KiB bank of m_sram at $A000-$BFFF, or -1 if reads
+	//	and writes there need read_sram()/write_sram().
+	template<typename T>
 	class CMapper : public CEmulatorComponent {
-		private:
 		public:
-			auto error_unimpl(const std::string& msg) -> void;
-			virtual auto name() const -> std::string = 0;
-			virtual auto read_rom(size_t addr) -> uint32_t = 0;
-			virtual auto read_sram(size_t addr) -> uint32_t = 0;
-			virtual auto write_sram(size_t addr, int data) -> void = 0;
-			virtual auto write_rom(size_t addr, int data) -> void = 0;
-			virtual auto sram_serialize() -> Blob = 0;
-			virtual ~CMapper() {}
-			
-			virtual auto rom_bank() const -> int = 0;
+			auto error_unimpl(const std::string& msg) -> void {
+				std::printf("mapper '%s': error: unimplemented (%s)\n",
+					static_cast<T*>(this)->name().c_str(),msg.c_str()
+				);
+				std::exit(-1);
+			}
 	};
-	class CMapperNone : public CMapper {
+	class CMapperNone : public CMapper<CMapperNone> {
 		private:
 		public:
 			auto name() const -> std::string { return "none"; };
-			auto read_rom(size_t addr) -> uint32_t;
 			auto read_sram(size_t addr) -> uint32_t;
 			auto write_sram(size_t addr, int data) -> void;
 			auto write_rom(size_t addr, int data) -> void;
@@ -202,9 +311,10 @@ namespace fern {
 			CMapperNone() {}
 			~CMapperNone() {}
 
-			auto rom_bank() const -> int { return 0; }
+			auto rom_bank() const -> int { return 1; }
+			auto sram_bank() const -> int { return -1; }
 	};
-	class CMapperMBC1 : public CMapper {
+	class CMapperMBC1 : public CMapper<CMapperMBC1> {
 		private:
 			int m_banknum;
 			int m_banknum_hi;
@@ -214,7 +324,6 @@ namespace fern {
 			bool m_rambankmode;
 		public:
 			auto name() const -> std::string { return "MBC1"; };
-			auto read_rom(size_t addr) -> uint32_t;
 			auto read_sram(size_t addr) -> uint32_t;
 			auto write_sram(size_t addr, int data) -> void;
 			auto write_rom(size_t addr, int data) -> void;
@@ -233,8 +342,12 @@ namespace fern {
 			auto rom_bank() const -> int {
 				return rombank_get();
 			}
+			auto sram_bank() const -> int {
+				if(!m_useram) return -1;
+				return m_rambankmode ? m_banknum_hi : 0;
+			}
 	};
-	class CMapperMBC3 : public CMapper {
+	class CMapperMBC3 : public CMapper<CMapperMBC3> {
 		private:
 			int m_rambanknum;
 			int m_rombanknum;
@@ -252,7 +365,6 @@ namespace fern {
 			int m_rtcLatchReady;
 		public:
 			auto name() const -> std::string { return "MBC3"; };
-			auto read_rom(size_t addr) -> uint32_t;
 			auto read_sram(size_t addr) -> uint32_t;
 			auto write_sram(size_t addr, int data) -> void;
 			auto write_rom(size_t addr, int data) -> void;
@@ -267,8 +379,11 @@ namespace fern {
 			auto rom_bank() const -> int {
 				return rombank_get();
 			}
+			auto sram_bank() const -> int {
+				return (m_useram && !m_sramIsRTC) ? m_rambanknum : -1;
+			}
 	};
-	class CMapperMBC5 : public CMapper {
+	class CMapperMBC5 : public CMapper<CMapperMBC5> {
 		private:
 			int m_rambanknum;
 			int m_rombanknum;
@@ -281,7 +396,6 @@ namespace fern {
 			bool m_userumble;
 		public:
 			auto name() const -> std::string { return "MBC5"; };
-			auto read_rom(size_t addr) -> uint32_t;
 			auto read_sram(size_t addr) -> uint32_t;
 			auto write_sram(size_t addr, int data) -> void;
 			auto write_rom(size_t addr, int data) -> void;
@@ -296,7 +410,11 @@ namespace fern {
 			auto rom_bank() const -> int {
 				return rombank_get();
 			}
+			auto sram_bank() const -> int {
+				return m_useram ? m_rambanknum : -1;
+			}
 	};
+	using CMapperAny = std::variant<CMapperNone,CMapperMBC1,CMapperMBC3,CMapperMBC5>;
 
 	// memory -------------------------------------------@/
 	struct CRomBank {
@@ -350,6 +468,14 @@ namespace fern {
 		auto ppu_enabled() const -> bool {
 			return (m_LCDC & 0x80) != 0;
 		}
+		auto timer_enabled() const -> bool {
+			return (m_TAC & 0x04) != 0;
+		}
+		// cycles per TIMA increment
+		auto timer_limit() const -> int {
+			const std::array<int,4> timer_limts = { 256,4,16,64 };
+			return timer_limts[m_TAC & 0b11];
+		}
 
 		auto stat_getMode() const -> int {
 			return m_STAT & 0b11;
@@ -377,6 +503,30 @@ namespace fern {
 		constexpr auto bgpal_index() const -> int { return palreg_index(m_BGPI); }
 		constexpr auto objpal_index() const -> int { return palreg_index(m_OBPI); }
 	};
+	// data watchpoints. their pages are left unmapped, so only accesses to
+	// those pages go through the slow path and get checked.
+	namespace WatchKind {
+		enum {
+			read = 1,
+			write = 2,
+			change = 4, // writes that change the value
+		};
+	}
+	struct CWatchpoint {
+		int bank; // numbered like RGBDS, -1 for any bank
+		int start; // inclusive
+		int end;
+		int kind; // WatchKind, can be more than one
+	};
+	struct CWatchHit {
+		int kind;
+		int bank;
+		int addr;
+		int old_value;
+		int new_value; // same as old_value for reads
+		int pc; // instruction that did it, -1 without the history
+	};
+
 	class CMem : public CEmulatorComponent {
 		public:
 			std::array<uint8_t,2 * KBSIZE(8)> m_vram; // 2x8kib
@@ -391,24 +541,52 @@ namespace fern {
 
 			int m_rambankCount;
 			int m_rombankCount;
+			int m_rombankLatched; // mapper's ROM bank, updated on ROM writes
+
+			CMapperAny m_mapper;
+
+			// one pointer per 256-byte page, to the memory it's mapped to.
+			// null pages (IO, OAM, mapper registers, VRAM during mode 3,
+			// SRAM the mapper handles) go through read_slow()/write_slow().
+			std::array<const uint8_t*,0x100> m_pageRead;
+			std::array<uint8_t*,0x100> m_pageWrite;
+			bool m_pageVRAMWritable;
+			uint64_t m_vramDirty; // 256 byte pages of VRAM written, for the PPU worker
 
-			CMapper* m_mapper;
+			std::vector<CWatchpoint> m_watchpoints;
+			std::array<uint8_t,0x100> m_watchPages; // WatchKinds watched per page
+			bool m_watchFired; // stopped the CPU since this was cleared
+			CWatchHit m_watchHit;
+
+			// set by model_set() when the ROM's loaded. this is the only
+			// copy of the model, everything else asks cgb_enabled().
+			bool m_modelCGB;
+			bool m_peeking; // in peek()
 
 			CMem();
-			~CMem();
 
 			auto reset() -> void;
+			auto model_set(bool cgb) -> void;
 
 			auto mapper_setupNone() -> void;
 			auto mapper_setupMBC1(bool use_ram, bool use_battery) -> void;
 			auto mapper_setupMBC3(bool use_ram, bool use_battery, bool use_timer) -> void;
 			auto mapper_setupMBC5(bool use_ram, bool use_battery, bool use_rumble) -> void;
+			auto mapper_name() -> std::string;
+			auto mapper_sramSerialize() -> Blob;
 
 			static auto palet_getLUT(int palflags) -> std::array<int,4>;
 
 			auto interrupt_match(int mask) -> bool;
 			auto interrupt_clear(int mask) -> void;
 			auto rombank_current() -> int;
+			auto rombank_latch() -> void;
+
+			auto pages_map(int page,int count,uint8_t* data,bool writable) -> void;
+			auto pages_mapAll() -> void;
+			auto pages_mapBanks() -> void;
+			auto pages_mapVRAM() -> void;
+			auto pages_mapWRAM() -> void;
 			auto oam_accessible() -> bool {
 				return ((m_io.stat_getMode()&1) == 0)
 					|| (!m_io.ppu_enabled())
@@ -422,13 +600,37 @@ namespace fern {
 			auto addr_inRange(size_t addr, size_t min,size_t max) -> bool {
 				return (addr >= min) && (addr < max);
 			}
-			auto read(size_t addr) -> uint32_t;
+			auto read(size_t addr) -> uint32_t {
+				addr &= 0xFFFF;
+				if(const uint8_t* page = m_pageRead[addr>>8]) {
+					return page[addr & 0xFF];
+				}
+				return read_slow(addr);
+			}
+			auto read_slow(size_t addr) -> uint32_t;
+			auto read_unwatched(size_t addr) -> uint32_t;
 			auto read_hram(int addr) -> uint32_t;
 			auto read_wram(int addr) -> int;
 			auto write(size_t addr, int data) -> void;
+			auto write_slow(size_t addr, int data) -> void;
+			auto write_unwatched(size_t addr, int data) -> void;
 			auto write_wram(int addr,int data) -> void;
 			auto write_hram(int addr,int data) -> void;
 			auto write_vram(int addr,int data) -> void;
+			auto peek(size_t addr) -> uint32_t;
+
+			auto watch_add(int bank,int start,int end,int kind) -> int;
+			auto watch_remove(int index) -> bool;
+			auto watch_list() const -> const std::vector<CWatchpoint>& { return m_watchpoints; }
+			auto watch_active() const -> bool { return !m_watchpoints.empty(); }
+			auto watch_pagesUpdate() -> void;
+			auto watch_read(int addr,int value) -> void;
+			auto watch_write(int addr,int data) -> void;
+			auto watch_match(int addr,int kind) -> bool;
+			auto watch_fire(int kind,int addr,int old_value,int new_value) -> void;
+			auto watch_fired() const -> bool { return m_watchFired; }
+			auto watch_hit() const -> const CWatchHit& { return m_watchHit; }
+			auto watch_clearFired() -> void { m_watchFired = false; }
 
 			auto stat_lycSync() -> void {
 				m_io.stat_setLYC(m_io.m_LY == m_io.m_LYC);
@@ -437,7 +639,6 @@ namespace fern {
 
 	// CPU ----------------------------------------------@/
 	typedef void (*CCPUInstrFn)(CCPU*,CEmulator*);
-	typedef void (*CCPUInstrPfxFn)(CCPU*,CEmulator*,int,int);
 	struct CCPUInstrBase {
 		std::string name;
 		CCPUInstrBase() {}
@@ -450,48 +651,202 @@ namespace fern {
 			name = instr_name;
 		}
 	};
-	struct CCPUInstrPfx : public CCPUInstrBase {
-		CCPUInstrPfxFn fn;
-		CCPUInstrPfx() {}
-		CCPUInstrPfx(CCPUInstrPfxFn fn_ptr,std::string instr_name) {
-			fn = fn_ptr;
-			name = instr_name;
-		}
-	};
+
+	// instruction history depth, can be set at build time. must be a power of
+	// 2 within 4-64K. defining FERN_NO_HISTORY compiles the history out.
+#ifndef FERN_HISTORY_DEPTH
+	#define FERN_HISTORY_DEPTH 4
+#endif
+	constexpr int INSTRHISTORY_DEPTH = FERN_HISTORY_DEPTH;
+	static_assert(INSTRHISTORY_DEPTH >= 4 && INSTRHISTORY_DEPTH <= KBSIZE(64),
+		"FERN_HISTORY_DEPTH must be within 4-65536"
+	);
+	static_assert((INSTRHISTORY_DEPTH & (INSTRHISTORY_DEPTH-1)) == 0,
+		"FERN_HISTORY_DEPTH must be a power of 2"
+	);
 
 	struct CInstrHistoryData {
-		int pc;
-		int bank;
-		std::vector<int> opcodedata;
+		uint16_t pc;
+		uint16_t bank;
+	};
 
-		CInstrHistoryData() 
-			: pc(0),bank(0),opcodedata({0})
-			{}
-		CInstrHistoryData(int mem_bank, int pcaddr, const std::vector<int>& opdata) {
-			pc = pcaddr;
-			bank = mem_bank;
-			opcodedata = opdata;
-		}
+	// profiler, compiled in by FERN_PROFILE. while it's enabled (--profile,
+	// or profile_enable()) it counts how often each opcode and each
+	// (bank,PC) runs, and their cycles. opcode entries 0x100-0x1FF are the
+	// CB opcodes. PCs are keyed like the block cache, (bank<<16) | pc.
+	constexpr int PROFILE_OPCODES = 0x200;
+	struct CProfileCount {
+		uint64_t count;
+		uint64_t cycles;
+	};
+	// label from a .sym file
+	struct CProfileSymbol {
+		uint32_t key; // (bank<<16) | addr
+		std::string name;
+	};
+	// call graph: a shadow stack follows calls, rsts and interrupts. each
+	// node is one call stack, for the flame graph.
+	constexpr int PROFILE_MAXDEPTH = 256;
+	struct CProfileNode {
+		int parent; // -1 for the root & interrupt handlers
+		uint32_t key; // function's (bank<<16) | addr
+		int irq; // interrupt vector, for handlers
+		uint64_t self;
+	};
+	struct CProfileFrame {
+		int node;
+		int sp; // where the return address is
+		uint64_t self;
+		uint64_t children; // not counting interrupts
+	};
+	struct CProfileFunction {
+		uint64_t calls;
+		uint64_t inclusive;
+		uint64_t exclusive;
+	};
+
+	// execution trace, compiled in by FERN_TRACE. every instruction's state
+	// before it runs goes into a ring of chunks, which a thread writes out
+	// to the file whole. emulation only waits if every chunk's full.
+	// --tracedump prints trace files in Gameboy Doctor's format.
+	struct CTraceRecord {
+		uint64_t cycle;
+		uint16_t pc;
+		uint16_t bank; // of the code at pc, see CCPU::code_bank()
+		uint16_t af,bc,de,hl,sp;
+		uint8_t bytes[4]; // at pc
+		uint8_t pad[6];
+	};
+	static_assert(sizeof(CTraceRecord) == 32,"trace records should be 32 bytes");
+
+	class CTracer {
+		public:
+			static constexpr int CHUNK_RECORDS = 0x8000; // 1MiB
+			static constexpr int CHUNK_COUNT = 16;
+		private:
+			std::vector<CTraceRecord> m_ring; // CHUNK_COUNT chunks
+			std::atomic<uint32_t> m_head; // chunks filled
+			std::atomic<uint32_t> m_tail; // chunks written
+			int m_pos; // records in the chunk being filled
+			uint64_t m_recordCount;
+			std::FILE* m_file;
+			std::thread m_thread;
+			std::mutex m_mutex;
+			std::condition_variable m_cond;
+			bool m_stopping;
+
+			auto chunk_publish() -> void;
+			auto writer_thread() -> void;
+		public:
+			CTracer();
+			~CTracer();
+
+			auto open(const std::string& filename) -> bool;
+			auto close() -> void;
+			auto is_open() const -> bool { return m_file != nullptr; }
+			auto record_count() const -> uint64_t { return m_recordCount; }
+			// the next record to fill in
+			auto record() -> CTraceRecord& {
+				if(m_pos == CHUNK_RECORDS) chunk_publish();
+				m_recordCount += 1;
+				const uint32_t chunk = m_head.load(std::memory_order_relaxed) % CHUNK_COUNT;
+				return m_ring[chunk*CHUNK_RECORDS + m_pos++];
+			}
 
-		constexpr int opcode_num() const { return opcodedata.at(0); }
+			static auto dump(const std::string& filename) -> bool;
 	};
 	
+	// last flag-setting ALU op, for lazy flags (FERN_LAZY_FLAGS).
+	namespace CPUFlagOp {
+		enum {
+			none,
+			logic_and,logic_or,
+			add,sub,
+			inc,dec
+		};
+	}
+
+	// cached core (FERN_CPUCORE_CACHED) -----------------@/
+#if defined(FERN_CPUCORE_THREADED) && defined(FERN_CPUCORE_CACHED)
+	#error "only one CPU core can be picked"
+#endif
+	// one instruction of a block, with its bytes read ahead of time.
+	struct CCPUDecodedInstr {
+		CCPUInstrFn fn;
+		uint16_t pc;
+		uint8_t opcode;
+		uint8_t length;
+		std::array<uint8_t,3> bytes;
+	};
+#ifdef FERN_JIT
+	#ifndef FERN_CPUCORE_CACHED
+		#error "the JIT needs the cached core (CPUCORE=cached)"
+	#endif
+	#if !defined(__x86_64__) && !defined(_M_X64)
+		#error "the JIT only targets x86-64"
+	#endif
+	// compiled block: runs the whole block, or stops early (an interrupt, a
+	// bank switch, run_until() stopping). returns how many instructions ran.
+	typedef int (*CCPUJitFn)();
+	constexpr int JIT_HOTCOUNT = 16; // times a block runs before it's compiled
+	constexpr int JIT_BUFSIZE = MBSIZE(4);
+#endif
+	// a run of instructions up to the next branch, from one ROM/WRAM bank.
+	struct CCPUBlock {
+		int bank;
+		std::vector<CCPUDecodedInstr> instrs;
+		bool breakpoint; // has an instruction in a page with breakpoints
+#ifdef FERN_JIT
+		int hits;
+		CCPUJitFn jitfn;
+#endif
+	};
+	constexpr int BLOCKCACHE_MAXLEN = 64;
+
+	// timed events, kept by CCPU as deadlines on the master clock.
+	namespace ClockEvent {
+		enum {
+			ppu, // next PPU mode change (LY increments with it)
+			tima, // next TIMA overflow
+			run, // end of the current run_until()
+			num_events
+		};
+	}
+	constexpr uint64_t CLOCKEVENT_NEVER = UINT64_MAX;
+
+	// idle loop skipping (off with FERN_NO_IDLESKIP) -----@/
+	constexpr int IDLELOOP_MAXLEN = 16; // longest loop looked at, in bytes
+	constexpr int IDLELOOP_MAXREADS = 4; // most memory reads in one
+
 	struct CCycle {
 		int num;
 		CCycle(int n) : num(n << 8) {}
 		auto full_cycles() -> int { return num >> 8; }
 	};
 
+	// PC breakpoints. the cores only look them up for pages that have one
+	// (m_breakPages), and the cached core only for blocks in those pages.
+	struct CBreakpoint {
+		int bank; // numbered like RGBDS, -1 for any bank
+		int addr;
+		uint32_t ignore; // hits before it stops
+		uint32_t hits;
+		bool temporary; // removed once it stops
+	};
 	class CCPU : public CEmulatorComponent {
 		private:
 			std::array<CCPUInstr,0x100> m_opcodetable;
-			std::array<CCPUInstrPfx,0x10> m_opcodetable_pfx;
 		public:
 			bool m_speedDoubled;
 			bool m_should_enableIME;
 			bool m_regIME;
 			bool m_haltwaiting;
 			uint8_t m_regA,m_regF;
+#ifdef FERN_LAZY_FLAGS
+			// F is only up to date when m_flagOp is none
+			int m_flagOp;
+			int m_flagOpA,m_flagOpB;
+#endif
 			uint8_t m_regB,m_regC;
 			uint8_t m_regD,m_regE;
 			uint8_t m_regH,m_regL;
@@ -504,15 +859,97 @@ namespace fern {
 			int m_dotclock;
 			int m_dotclockLimit;
 			int m_dotclockMode;
-			bool m_clockWaiting;
-			std::stack<int> m_clockWaitBuffer;
 
-			int m_timerctrDiv;
-			int m_timerctrMain;
+			// master clock, in cycles since reset. nothing else is updated
+			// per instruction: the PPU and timer counters catch up whenever
+			// the clock reaches the next event (see clock_update()).
+			uint64_t m_clockCycles;
+			uint64_t m_clockSynced; // where the counters were caught up to
+			uint64_t m_clockNextEvent;
+			uint64_t m_clockUpdates; // times clock_update() has run
+			std::array<uint64_t,ClockEvent::num_events> m_clockEvents;
+
+			// run_until() stops the cores once m_runStop is set, at the
+			// cycle limit or (if m_runToFrame) the start of vblank.
+			uint64_t m_runLimit;
+			bool m_runToFrame;
+			bool m_runStop;
+			bool m_frameDone; // a frame's finished since this was cleared
+
+			std::vector<CBreakpoint> m_breakpoints;
+			std::array<bool,0x100> m_breakPages; // 256 byte pages with breakpoints
+			bool m_breakStopped; // a breakpoint stopped run_until()
+			CBreakpoint m_breakLast; // which one
+			// where it stopped, so carrying on from there doesn't stop again
+			uint64_t m_breakClock;
+			int m_breakPC;
+
+#ifdef FERN_CPUCORE_CACHED
+			// keyed by bank<<16 | pc. RAM blocks go away whenever their
+			// code is written to, ROM blocks never change.
+			std::unordered_map<uint32_t,CCPUBlock> m_blockcacheRom;
+			std::unordered_map<uint32_t,CCPUBlock> m_blockcacheRam;
+			std::array<uint8_t,KBSIZE(16)/8> m_blockcacheRamCode; // 1 bit per byte, $C000-$FFFF
+			bool m_blockcacheRamDirty;
+			const uint8_t* m_pcbytes; // current instruction's bytes, if cached
+#endif
+#ifdef FERN_JIT
+			uint8_t* m_jitBuffer;
+			size_t m_jitUsed;
+			// off, every block runs on the interpreter. the selftest runs
+			// the same code both ways and compares.
+			bool m_jitEnabled;
+#endif
 
-			std::deque<CInstrHistoryData> m_instrhistory;
+			// DIV & TIMA are worked out from the master clock when read
+			uint64_t m_timerDivStamp; // when DIV was last cleared
+			uint64_t m_timerSynced; // when TIMA was last caught up
+			int m_timerctrMain; // cycles towards the next TIMA increment
+
+#ifndef FERN_NO_IDLESKIP
+			// last backward jr & its target, and the state at that point
+			int m_idleLoopPC;
+			int m_idleLoopBranch;
+			int m_idleLoopBank;
+			int m_idleLoopInstrs; // instructions per iteration, 0 if unskippable
+			std::array<int,IDLELOOP_MAXREADS> m_idleLoopReads; // address, or IDLEREAD_*
+			int m_idleLoopReadCount;
+			std::array<int,5> m_idleLoopRegs; // AF,BC,DE,HL,SP
+			std::array<int,IDLELOOP_MAXREADS> m_idleLoopValues;
+			uint64_t m_idleLoopCycles;
+			uint64_t m_idleLoopIterCycles; // cycles per iteration, once known
+			uint64_t m_idleLoopUpdates;
+			uint64_t m_idleSkips;
+			uint64_t m_idleSkippedCycles;
+#endif
+
+#ifndef FERN_NO_HISTORY
+			std::array<CInstrHistoryData,INSTRHISTORY_DEPTH> m_instrhistory;
+			uint32_t m_instrhistoryPos;
+#endif
+#ifdef FERN_PROFILE
+			std::array<CProfileCount,PROFILE_OPCODES> m_profileOpcodes;
+			std::unordered_map<uint32_t,CProfileCount> m_profileSpots;
+			std::vector<CProfileSymbol> m_profileSymbols; // sorted by key
+			bool m_profileEnabled;
+			int m_profileLast; // entry the running instruction's in, or -1
+			CProfileCount* m_profileLastSpot; // and its spot
+			uint64_t m_profileStart; // cycle it started on
+			std::vector<CProfileNode> m_profileNodes;
+			std::unordered_map<uint64_t,int> m_profileNodeIndex; // (parent<<32) | key
+			std::vector<CProfileFrame> m_profileStack;
+			std::unordered_map<uint32_t,CProfileFunction> m_profileFunctions;
+			std::array<CProfileFunction,3> m_profileIrqs; // vblank, STAT, timer
+			uint64_t m_profileStackClock; // cycle the stack last changed on
+#endif
+#ifdef FERN_TRACE
+			CTracer m_tracer;
+#endif
 
 			CCPU();
+#ifdef FERN_JIT
+			~CCPU();
+#endif
 
 			constexpr auto pc_set(std::size_t addr) { m_PC = addr; }
 			constexpr auto pc_increment(std::size_t offset) { m_PC += offset; }
@@ -522,10 +959,88 @@ namespace fern {
 			auto dotclock_reset() -> void;
 
 			auto instrhistory_get(int index) -> CInstrHistoryData;
-			auto instrhistory_push(int bank, int pc, const std::vector<int>& opcodedata) -> void;
+			auto instrhistory_push(int bank, int pc) -> void {
+#ifndef FERN_NO_HISTORY
+				const uint32_t mask = INSTRHISTORY_DEPTH - 1;
+				m_instrhistory[m_instrhistoryPos & mask] = {
+					static_cast<uint16_t>(pc),
+					static_cast<uint16_t>(bank)
+				};
+				m_instrhistoryPos += 1;
+#endif
+			}
 			auto instrhistory_pushCurrent() -> void;
+			constexpr auto instrhistory_size() const -> int {
+#ifndef FERN_NO_HISTORY
+				return INSTRHISTORY_DEPTH;
+#else
+				return 0;
+#endif
+			}
+
+			auto profile_enable(bool enable) -> void;
+			auto profile_reset() -> void;
+			auto profile_report() -> void;
+			auto profile_count(int opcode,int pc) -> void;
+			auto profile_spotKey(int pc) -> uint32_t;
+			auto profile_symbolFind(uint32_t key) -> const CProfileSymbol*;
+			auto profile_loadSymbols(const std::string& filename) -> bool;
+			auto profile_writeCollapsed(const std::string& filename) -> bool;
+			auto profile_stackReset() -> void;
+			auto profile_stackCharge() -> void;
+			auto profile_enter(int addr,int sp,int irq) -> void;
+			auto profile_leave(int sp) -> void;
+			auto profile_nodeName(int node) -> std::string;
+			// sp is after pushing/popping the return address
+			auto profile_call(int addr,int sp) -> void {
+#ifdef FERN_PROFILE
+				if(m_profileEnabled) profile_enter(addr,sp,0);
+#endif
+			}
+			auto profile_interrupt(int vector) -> void {
+#ifdef FERN_PROFILE
+				if(m_profileEnabled) profile_enter(vector,m_SP,vector);
+#endif
+			}
+			auto profile_return(int sp) -> void {
+#ifdef FERN_PROFILE
+				if(m_profileEnabled) profile_leave(sp);
+#endif
+			}
+
+			auto trace_start(const std::string& filename) -> void;
+			auto trace_stop() -> void;
+			auto trace_record(int pc) -> void;
+			auto trace_enabled() const -> bool {
+#ifdef FERN_TRACE
+				return m_tracer.is_open();
+#else
+				return false;
+#endif
+			}
+			// called as each instruction starts, with the registers in the CCPU
+			auto trace_begin(int pc) -> void {
+#ifdef FERN_TRACE
+				if(m_tracer.is_open()) trace_record(pc);
+#endif
+			}
+			// called as each instruction starts, next to instrhistory_push()
+			auto profile_begin(int opcode,int pc) -> void {
+#ifdef FERN_PROFILE
+				if(m_profileEnabled) profile_count(opcode,pc);
+#endif
+			}
+			constexpr auto profile_enabled() const -> bool {
+#ifdef FERN_PROFILE
+				return m_profileEnabled;
+#else
+				return false;
+#endif
+			}
 
 			auto flag_syncAnd(int opA,int opB) -> void;
+			auto flag_syncOr(int opA,int opB) -> void;
+			auto flag_syncXor(int opA,int opB) -> void;
 			auto flag_syncAdd16(uint32_t opA,uint32_t opB) -> void;
 			auto flag_syncCompare(int opA,int opB) -> void;
 			auto flag_syncCompareAdd(int opA, int opB) -> void;
@@ -545,21 +1060,124 @@ namespace fern {
 			auto call(int addr, int retaddr) -> void;
 			auto calreturn(bool enable_intr = false) -> void;
 
-			auto halt_waitStart() -> void { m_haltwaiting = true; }
+			auto halt_waitStart() -> void { m_haltwaiting = true; clock_reschedule(); }
 			auto halt_isWaiting() -> bool { return m_haltwaiting; }
-			auto clock_tick(int cyclecnt) -> void;
+			auto halt_run() -> void;
+			auto clock_tick(int cyclecnt) -> void {
+				m_clockCycles += cyclecnt;
+				if(m_clockCycles >= m_clockNextEvent) clock_update();
+			}
+			auto clock_update() -> void;
+			auto clock_catchup() -> void;
+			auto clock_schedule() -> void;
+			// makes the next clock_tick() check everything, for when IO
+			// writes change what the events depend on.
+			auto clock_reschedule() -> void { m_clockNextEvent = 0; }
+			auto clock_cycles() const -> uint64_t { return m_clockCycles; }
+			auto speed_set(bool doubled) -> void;
+
+			auto timer_div() -> int;
+			auto timer_divReset() -> void;
+			auto timer_tima() -> int;
+			auto timer_writeTIMA(int data) -> void;
+			auto timer_writeTAC(int data) -> void;
+			auto timer_catchup() -> void;
+
+			// called by the cores after a backward jr's taken. returns how
+			// many instructions were skipped, out of instrs_left.
+#ifndef FERN_NO_IDLESKIP
+			auto idle_skip(int branch_pc,int instrs_left) -> int;
+			auto idle_decode(int target,int branch_pc) -> void;
+			auto idle_reset() -> void;
+#else
+			auto idle_skip(int branch_pc,int instrs_left) -> int { return 0; }
+			auto idle_reset() -> void {}
+#endif
 
 			auto opcode_clear() -> void;
 			auto opcode_set(std::size_t index,CCPUInstr instr) -> void;
 			auto opcode_setRaw(std::size_t index,CCPUInstr instr) -> void;
-			auto opcode_setPrefix(std::size_t index,CCPUInstrPfx instr) -> void;
+			auto opcode_setGroup(std::size_t index,const std::array<CCPUInstrFn,16>& fns,const char* name_lo,const char* name_hi) -> void;
+			auto opcode_run(int opcode_num) -> void;
 
 			auto print_status(bool instr_history = false) -> void;
+			auto code_bank(int pc) -> int;
+
+			auto break_reset() -> void;
+			auto break_add(int bank,int addr,uint32_t ignore,bool temporary) -> int;
+			auto break_remove(int index) -> bool;
+			auto break_list() const -> const std::vector<CBreakpoint>& { return m_breakpoints; }
+			auto break_pagesUpdate() -> void;
+			auto break_hit(int pc) -> bool;
+			// called before each instruction in run(). true if it shouldn't run.
+			auto break_check(int pc) -> bool {
+				return m_breakPages[pc>>8] && break_hit(pc);
+			}
+			auto break_stopped() const -> bool { return m_breakStopped; }
+			auto break_last() const -> const CBreakpoint& { return m_breakLast; }
+			// also lets run() carry on, after a stop outside run_until()
+			auto break_clearStop() -> void {
+				m_breakStopped = false;
+				m_runStop = false;
+			}
+			// stops run_until() once the current instruction's done
+			auto break_stop() -> void {
+				m_breakStopped = true;
+				m_runStop = true;
+			}
+
+#ifdef FERN_CPUCORE_CACHED
+			auto blockcache_clear() -> void;
+			auto blockcache_bank(int addr) -> int;
+			auto blockcache_find() -> CCPUBlock*;
+			auto blockcache_build(int bank) -> CCPUBlock;
+			auto blockcache_instrBegin(const CCPUDecodedInstr& instr) -> void;
+			auto blockcache_breakpointsUpdate() -> void;
+			// called by CMem on every write, marks RAM blocks as stale.
+			auto blockcache_written(int addr) -> void {
+				if(addr < 0xC000) return;
+				if(addr >= 0xE000 && addr < 0xFE00) addr -= 0x2000; // echo RAM
+				const int index = addr - 0xC000;
+				if(m_blockcacheRamCode[index>>3] & (1<<(index&7))) {
+					m_blockcacheRamDirty = true;
+				}
+			}
+#endif
+#ifdef FERN_JIT
+			auto jit_compile(const CCPUBlock& block) -> CCPUJitFn;
+			auto jit_flush() -> void;
+			// called from compiled code
+			static auto jit_clockUpdate(CCPU* cpu) -> void;
+#ifdef FERN_LAZY_FLAGS
+			static auto jit_flagMaterialize(CCPU* cpu) -> void;
+#endif
+#endif
 
 			auto reset() -> void;
+			auto run(int instr_count) -> void;
+			auto run_until(uint64_t cycle_limit,bool to_frame) -> void;
 			auto step() -> void;
 			auto execute_opcode() -> void;
+			// works out F from the last recorded op, if there is one.
+			constexpr auto flag_materialize() -> void {
+#ifdef FERN_LAZY_FLAGS
+				if(m_flagOp != CPUFlagOp::none) flag_materializeOp();
+#endif
+			}
+			auto flag_materializeOp() -> void;
+			constexpr auto reg_f() -> int { flag_materialize(); return m_regF; }
+			constexpr auto f_set(int num) -> void {
+#ifdef FERN_LAZY_FLAGS
+				m_flagOp = CPUFlagOp::none;
+#endif
+				m_regF = num;
+			}
+			// sets all 4 flags at once, without needing the old ones.
+			constexpr auto flag_setAll(bool zero,bool subtract,bool halfcarry,bool carry) -> void {
+				f_set((zero<<7) | (subtract<<6) | (halfcarry<<5) | (carry<<4));
+			}
 			constexpr auto flag_setBit(int index, bool flag) -> void {
+				flag_materialize();
 				m_regF &= (0xFF ^ (1<<index));
 				m_regF |= flag<<index;
 			}
@@ -575,11 +1193,11 @@ namespace fern {
 			constexpr auto flag_setCarry(bool flag) -> void {
 				flag_setBit(4,flag);
 			}
-			constexpr auto flag_zero() -> bool { return (m_regF>>7)&1; }
-			constexpr auto flag_subtract() -> bool { return (m_regF>>6)&1; }
-			constexpr auto flag_halfcarry() -> bool { return (m_regF>>5)&1; }
-			constexpr auto flag_carry() -> bool { return (m_regF>>4)&1; }
-			constexpr auto reg_af() -> int { return (m_regA<<8) | m_regF; }
+			constexpr auto flag_zero() -> bool { return (reg_f()>>7)&1; }
+			constexpr auto flag_subtract() -> bool { return (reg_f()>>6)&1; }
+			constexpr auto flag_halfcarry() -> bool { return (reg_f()>>5)&1; }
+			constexpr auto flag_carry() -> bool { return (reg_f()>>4)&1; }
+			constexpr auto reg_af() -> int { return (m_regA<<8) | reg_f(); }
 			constexpr auto reg_bc() -> int { return (m_regB<<8) | m_regC; }
 			constexpr auto reg_de() -> int { return (m_regD<<8) | m_regE; }
 			constexpr auto reg_hl() -> int { return (m_regH<<8) | m_regL; }
@@ -602,55 +1220,173 @@ namespace fern {
 
 	};
 
+	// GDB remote stub, compiled in by FERN_GDB. it listens on a local TCP
+	// port (--gdb), and is polled by the emulation thread between frames,
+	// so the game runs at full speed until gdb interrupts it or something
+	// stops the CPU. while it's stopped, the emulation thread serves gdb.
+	// registers are in the order of gdb's z80 target (af,bc,de,hl,sp,pc,
+	// then the z80-only ones, always 0).
+	class CGdbStub : public CEmulatorComponent {
+		public:
+			static constexpr int REGISTER_COUNT = 13;
+		private:
+			intptr_t m_listenSocket; // -1 if not listening
+			intptr_t m_socket; // -1 if gdb isn't connected
+			std::string m_input; // received, not handled yet
+			bool m_stopped; // waiting on gdb
+			std::string m_stopReply; // why, for '?'
+
+			auto receive() -> bool;
+			auto disconnect() -> void;
+			auto packet_next(std::string& packet) -> bool;
+			auto packet_send(const std::string& data) -> void;
+			auto packet_handle(const std::string& packet) -> void;
+			auto register_get(int index) -> int;
+			auto register_set(int index,int value) -> void;
+			auto stop_reply() -> std::string;
+			auto point_set(const std::string& packet,bool insert) -> bool;
+		public:
+			CGdbStub();
+			~CGdbStub();
+
+			auto listen(int port) -> bool;
+			auto close() -> void;
+			auto connected() const -> bool { return m_socket != -1; }
+			auto stopped() const -> bool { return m_stopped; }
+			auto poll() -> void;
+			auto stop() -> void;
+			auto serve() -> void;
+	};
+
+	// input --------------------------------------------@/
+	// a button going down or up, at a point on the master clock.
+	struct CInputEvent {
+		uint64_t time;
+		uint8_t button;
+		bool pressed;
+	};
+	// single producer/single consumer ring, from the UI thread to the
+	// emulation thread. neither side ever waits on the other.
+	class CInputQueue {
+		public:
+			static const uint32_t CAPACITY = 256; // power of 2
+		private:
+			std::array<CInputEvent,CAPACITY> m_events;
+			std::atomic<uint32_t> m_head; // next to pop, consumer only
+			std::atomic<uint32_t> m_tail; // next to push, producer only
+		public:
+			CInputQueue() : m_head(0),m_tail(0) {}
+
+			// producer. returns false (and drops the event) if it's full.
+			auto push(const CInputEvent& event) -> bool {
+				const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+				if(tail - m_head.load(std::memory_order_acquire) >= CAPACITY) return false;
+				m_events[tail & (CAPACITY-1)] = event;
+				m_tail.store(tail + 1,std::memory_order_release);
+				return true;
+			}
+			// consumer. front() looks at the oldest event without taking it.
+			auto front(CInputEvent& event) const -> bool {
+				const uint32_t head = m_head.load(std::memory_order_relaxed);
+				if(head == m_tail.load(std::memory_order_acquire)) return false;
+				event = m_events[head & (CAPACITY-1)];
+				return true;
+			}
+			auto pop() -> void {
+				m_head.store(m_head.load(std::memory_order_relaxed) + 1,std::memory_order_release);
+			}
+	};
+
 	// emulator -----------------------------------------@/
 	struct CEmuInitFlags {
 		bool vsync;
 		bool debug;
 		bool verbose;
+		bool profile;
+		std::string symfile; // labels for the profiler, instead of <rom>.sym
+		std::string tracefile; // execution trace's written here, if set
+		int gdbport; // GDB stub's port, 0 for none
 
 		CEmuInitFlags()
-			: vsync(false),debug(false),verbose(false)
+			: vsync(false),debug(false),verbose(false),profile(false),gdbport(0)
 			{}
 	};
 	
 	class CEmulator {
 		public:
 			static const int SAVE_DURATION = 1000*5;
+			// 154 lines of 456 dots, at normal speed.
+			static const int FRAME_CYCLES = 154*456/4;
 		private:
-			bool m_quitflag;
-			bool m_cgbEnabled;
+			std::atomic<bool> m_quitflag;
 			bool m_nowaitEnable;
 			bool m_verboseEnable;
-			bool m_debugEnable;
-			bool m_debugSkipping;
-			int m_debugSkipAddr;
+			std::atomic<bool> m_debugEnable;
 			int m_savetimer;
 			std::string m_romfilename;
-			std::array<bool,EmuButton::num_keys> m_joypad_state;
+			std::string m_symfilename;
+			std::string m_tracefilename;
+			int m_gdbPort;
+
+			// input: sampled on the UI thread, applied on the emulation
+			// thread at the start of each frame.
+			CInputQueue m_inputQueue;
+			std::atomic<uint64_t> m_inputClock; // master clock at the last frame
+			uint8_t m_inputHeld; // UI thread's view, packed like m_joypad
+			uint8_t m_joypad; // 1 bit per EmuButton, set if held
+
+			// finished frames are handed to the UI thread to present
+			std::mutex m_frameMutex;
+			std::condition_variable m_frameCond;
+			bool m_frameReady;
 		public:
 			CCPU cpu;
 			CMem mem;
 			CRenderer renderer;
+			CGdbStub gdb;
 
 			CEmulator(const CEmuInitFlags* flags);
 			~CEmulator();
 
 			auto savedata_sync() -> void;
 			auto savedata_getFilename() -> std::optional<std::string>;
+			auto symbols_getFilename() -> std::optional<std::string>;
 
 			auto process_message() -> void;
+			auto input_push(int btn,bool pressed) -> void;
+			auto input_apply() -> void;
 			auto button_held(int btn) -> bool;
+			auto joypad_state() const -> int { return m_joypad; }
+			auto frame_publish() -> void;
+			auto frame_present() -> void;
 
 			auto nowait_set(bool nowait) -> void;
 			auto nowait_toggle() -> void;
 			auto nowait_isEnabled() const -> bool { return m_nowaitEnable; }
 
 			auto verbose_enabled() const -> bool { return m_verboseEnable; }
-			auto cgb_enabled() const -> bool { return m_cgbEnabled; }
+			// the model's only kept by CMem, see CMem::model_set()
+			auto cgb_enabled() const -> bool { return mem.m_modelCGB; }
 			auto debug_on() const -> bool { return m_debugEnable; }
 			auto debug_set(bool enable) -> void { m_debugEnable = enable; }
+			auto debug_reportStop() -> bool;
 
+			auto run_frame() -> void;
+			auto run_cycles(uint64_t cycles) -> void;
+			auto emu_thread() -> void;
 			auto boot() -> void;
+			auto bench_reads() -> void;
+			auto bench_lines() -> void;
+			auto selftest_run() -> bool;
+			auto selftest_load(const std::vector<uint8_t>& code) -> void;
+			auto selftest_runCycles() -> bool;
+			auto selftest_runFrame() -> bool;
+			auto selftest_watchWrite() -> bool;
+			auto selftest_watchDecode() -> bool;
+			auto selftest_watchResume() -> bool;
+#ifdef FERN_JIT
+			auto selftest_jit() -> bool;
+#endif
 			auto load_romfile(const std::string& filename) -> void;
 			auto quit() -> void { m_quitflag = true; }
 			auto did_quit() -> bool { return m_quitflag; }
@@ -0,0 +1,50 @@
+#include <fern.h>
+#include <chrono>
+
+// benchmarks ---------------------------------------------------------------@/
+// run with --bench, after the ROM's been loaded. bench_reads() times
+// CMem::read() over each region, bench_lines() times drawing lines with
+// whatever's in VRAM.
+namespace fern {
+	auto CEmulator::bench_reads() -> void {
+		constexpr int READ_COUNT = 1<<24;
+		struct BenchRegion {
+			const char* name;
+			int base;
+			int size; // power of 2
+		};
+		const BenchRegion regions[] = {
+			{ "ROM bank 0",0x0000,0x4000 },
+			{ "ROM bank n",0x4000,0x4000 },
+			{ "SRAM",0xA000,0x2000 },
+			{ "WRAM",0xC000,0x1000 },
+			{ "OAM",0xFE00,0x80 }
+		};
+
+		std::printf("mapper: %s\n",mem.mapper_name().c_str());
+		for(const auto& region : regions) {
+			// summed, so the reads can't be left out
+			uint32_t sum = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for(int i=0; i<READ_COUNT; i++) {
+				sum += mem.read(region.base + (i & (region.size - 1)));
+			}
+			const auto end = std::chrono::steady_clock::now();
+			const double ns = std::chrono::duration<double,std::nano>(end - start).count();
+			std::printf("%-12s %6.2f ns/read (sum %08X)\n",region.name,ns / READ_COUNT,sum);
+		}
+	}
+	auto CEmulator::bench_lines() -> void {
+		constexpr int FRAME_COUNT = 2000;
+		const auto input = renderer.line_input();
+		const auto start = std::chrono::steady_clock::now();
+		for(int i=0; i<FRAME_COUNT; i++) {
+			for(int y=0; y<SCREEN_Y; y++) {
+				renderer.draw_lineCGB(y,input);
+			}
+		}
+		const auto end = std::chrono::steady_clock::now();
+		const double ns = std::chrono::duration<double,std::nano>(end - start).count();
+		std::printf("%-12s %6.2f ns/line\n","CGB lines",ns / (FRAME_COUNT*SCREEN_Y));
+	}
+}
@@ -0,0 +1,63 @@
+#include <fern.h>
+#include <fern_common.h>
+
+// breakpoints --------------------------------------------------------------@/
+// run() checks m_breakPages before each instruction, and only looks through
+// the breakpoints for pages that have one. step() never stops, so the
+// debugger can always step past one.
+namespace fern {
+	auto CCPU::break_reset() -> void {
+		m_breakpoints.clear();
+		m_breakStopped = false;
+		m_breakLast = {};
+		m_breakClock = 0;
+		m_breakPC = -1;
+		break_pagesUpdate();
+	}
+
+	auto CCPU::break_add(int bank,int addr,uint32_t ignore,bool temporary) -> int {
+		m_breakpoints.push_back({ bank,addr & 0xFFFF,ignore,0,temporary });
+		break_pagesUpdate();
+		return m_breakpoints.size() - 1;
+	}
+	auto CCPU::break_remove(int index) -> bool {
+		if(index < 0 || index >= static_cast<int>(m_breakpoints.size())) return false;
+		m_breakpoints.erase(m_breakpoints.begin() + index);
+		break_pagesUpdate();
+		return true;
+	}
+	auto CCPU::break_pagesUpdate() -> void {
+		m_breakPages.fill(false);
+		for(const auto& bp : m_breakpoints) {
+			m_breakPages[bp.addr>>8] = true;
+		}
+#ifdef FERN_CPUCORE_CACHED
+		blockcache_breakpointsUpdate();
+#endif
+	}
+
+	// something's in pc's page. stops run_until() if one of its breakpoints
+	// is at pc, in the right bank, and has been hit more than it ignores.
+	auto CCPU::break_hit(int pc) -> bool {
+		// carrying on from where the last one stopped
+		if(pc == m_breakPC && m_clockCycles == m_breakClock) return false;
+
+		const int bank = code_bank(pc);
+		for(size_t i=0; i<m_breakpoints.size(); i++) {
+			auto& bp = m_breakpoints[i];
+			if(bp.addr != pc || (bp.bank >= 0 && bp.bank != bank)) continue;
+			bp.hits += 1;
+			if(bp.hits <= bp.ignore) continue;
+
+			m_breakStopped = true;
+			m_breakLast = bp;
+			m_breakLast.bank = bank;
+			m_breakClock = m_clockCycles;
+			m_breakPC = pc;
+			m_runStop = true;
+			if(bp.temporary) break_remove(i);
+			return true;
+		}
+		return false;
+	}
+}
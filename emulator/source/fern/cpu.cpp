@@ -1,11 +1,58 @@
 #include <fern.h>
 #include <fern_common.h>
+#include <algorithm>
+#include <utility>
+#include <climits>
 
 #define INSTRFN_NAME(name) fernOpcodes :: op_##name
 #define fern_opcodefn(name) void op_##name (fern::CCPU* cpu,fern::CEmulator* emu)
-#define fern_opcodepfxfn(name) void op_##name (fern::CCPU* cpu,fern::CEmulator* emu, int register_id, int opcode_mode)
+#define fern_opcodegrpfn(name) template<int register_id,int opcode_mode> fern_opcodefn(name)
+#define fern_opcodecbfn(name) template<int cb_opcode> fern_opcodefn(name)
+// all 16 instantiations of a grouped opcode, in the same order as its
+// opcodes ($x0-$x7 with mode 0, then $x8-$xF with mode 1).
+#define INSTRFN_GROUP(name) { \
+	INSTRFN_NAME(name)<0,0>,INSTRFN_NAME(name)<1,0>,INSTRFN_NAME(name)<2,0>,INSTRFN_NAME(name)<3,0>, \
+	INSTRFN_NAME(name)<4,0>,INSTRFN_NAME(name)<5,0>,INSTRFN_NAME(name)<6,0>,INSTRFN_NAME(name)<7,0>, \
+	INSTRFN_NAME(name)<0,1>,INSTRFN_NAME(name)<1,1>,INSTRFN_NAME(name)<2,1>,INSTRFN_NAME(name)<3,1>, \
+	INSTRFN_NAME(name)<4,1>,INSTRFN_NAME(name)<5,1>,INSTRFN_NAME(name)<6,1>,INSTRFN_NAME(name)<7,1>, \
+}
 
 namespace fernOpcodes {
+	// grouped opcode operands --------------------------@/
+	// the $40-$BF blocks take their operand from the low 3 bits of the opcode.
+	// each one is a template over that register, so plain registers are
+	// picked at compile time, and only [hl] goes through memory.
+	template<int register_id>
+	inline auto grp_reg(fern::CCPU* cpu) -> uint8_t& {
+		using namespace fern::RegisterName;
+		static_assert(!is_hldata(register_id),"[hl] isn't a register");
+		if constexpr(register_id == B) return cpu->m_regB;
+		else if constexpr(register_id == C) return cpu->m_regC;
+		else if constexpr(register_id == D) return cpu->m_regD;
+		else if constexpr(register_id == E) return cpu->m_regE;
+		else if constexpr(register_id == H) return cpu->m_regH;
+		else if constexpr(register_id == L) return cpu->m_regL;
+		else return cpu->m_regA;
+	}
+	template<int register_id>
+	inline auto grp_read(fern::CCPU* cpu,fern::CEmulator* emu) -> uint8_t {
+		if constexpr(fern::RegisterName::is_hldata(register_id)) {
+			return emu->mem.read(cpu->reg_hl());
+		} else {
+			return grp_reg<register_id>(cpu);
+		}
+	}
+	template<int register_id>
+	inline auto grp_write(fern::CCPU* cpu,fern::CEmulator* emu,uint8_t data) -> void {
+		if constexpr(fern::RegisterName::is_hldata(register_id)) {
+			emu->mem.write(cpu->reg_hl(),data);
+		} else {
+			grp_reg<register_id>(cpu) = data;
+		}
+	}
+	template<int register_id>
+	constexpr int grp_ticks = fern::RegisterName::is_hldata(register_id) ? 2 : 1;
+
 	// bitwise ops
 	fern_opcodefn(and_a_imm8) {
 		cpu->flag_syncAnd(cpu->m_regA,cpu->read_pc(1));
@@ -14,96 +61,48 @@ namespace fernOpcodes {
 		cpu->clock_tick(2);
 	}
 	fern_opcodefn(or_a_imm8) {
-		cpu->m_regA |= cpu->read_pc(1);
-		cpu->flag_setZero(cpu->m_regA == 0);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry(false);
-		cpu->flag_setCarry(false);
+		int operand = cpu->read_pc(1);
+		cpu->flag_syncOr(cpu->m_regA,operand);
+		cpu->m_regA |= operand;
 
 		cpu->pc_increment(2);
 		cpu->clock_tick(2);
 	}
 	fern_opcodefn(xor_a_imm8) {
-		cpu->m_regA ^= cpu->read_pc(1);
-		cpu->flag_setZero(cpu->m_regA == 0);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry(false);
-		cpu->flag_setCarry(false);
+		int operand = cpu->read_pc(1);
+		cpu->flag_syncXor(cpu->m_regA,operand);
+		cpu->m_regA ^= operand;
 
 		cpu->pc_increment(2);
 		cpu->clock_tick(2);
 	}
 
-	fern_opcodepfxfn(andxor) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
-
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
+	fern_opcodegrpfn(andxor) {
+		const int operand = grp_read<register_id>(cpu,emu);
 
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) {
-			auto result = (cpu->m_regA & cur_reg());
-			cpu->m_regA = result;
-			cpu->flag_setZero(result == 0);
-			cpu->flag_setSubtract(false);
-			cpu->flag_setHalfcarry(true);
-			cpu->flag_setCarry(false);
+		if constexpr(!opcode_mode) {
+			cpu->flag_syncAnd(cpu->m_regA,operand);
+			cpu->m_regA &= operand;
 		} else {
-			auto result = (cpu->m_regA ^ cur_reg());
-			cpu->m_regA = result;
-			cpu->flag_setZero(result == 0);
-			cpu->flag_setSubtract(false);
-			cpu->flag_setHalfcarry(false);
-			cpu->flag_setCarry(false);
+			cpu->flag_syncXor(cpu->m_regA,operand);
+			cpu->m_regA ^= operand;
 		}
 
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
+		cpu->pc_increment(1);
+		cpu->clock_tick(grp_ticks<register_id>);
 	}
-	fern_opcodepfxfn(orcp) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
-
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
+	fern_opcodegrpfn(orcp) {
+		const int operand = grp_read<register_id>(cpu,emu);
 
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) {
-			auto result = (cpu->m_regA | cur_reg());
-			cpu->m_regA = result;
-			cpu->flag_setZero(result == 0);
-			cpu->flag_setSubtract(false);
-			cpu->flag_setHalfcarry(false);
-			cpu->flag_setCarry(false);
+		if constexpr(!opcode_mode) {
+			cpu->flag_syncOr(cpu->m_regA,operand);
+			cpu->m_regA |= operand;
 		} else {
-			cpu->flag_syncCompare(cpu->m_regA,cur_reg());
+			cpu->flag_syncCompare(cpu->m_regA,operand);
 		}
 
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
+		cpu->pc_increment(1);
+		cpu->clock_tick(grp_ticks<register_id>);
 	}
 
 	// TODO: check rotate operation.
@@ -112,10 +111,7 @@ namespace fernOpcodes {
 		cpu->m_regA <<= 1;
 		cpu->m_regA |= hibit;
 
-		cpu->flag_setZero(false);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry(false);
-		cpu->flag_setCarry(hibit);
+		cpu->flag_setAll(false,false,false,hibit);
 	
 		cpu->pc_increment(1);
 		cpu->clock_tick(1);
@@ -126,10 +122,7 @@ namespace fernOpcodes {
 		cpu->m_regA <<= 1;
 		cpu->m_regA |= carry;
 
-		cpu->flag_setZero(false);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry(false);
-		cpu->flag_setCarry(hibit);
+		cpu->flag_setAll(false,false,false,hibit);
 	
 		cpu->pc_increment(1);
 		cpu->clock_tick(1);	
@@ -139,10 +132,7 @@ namespace fernOpcodes {
 		cpu->m_regA >>= 1;
 		cpu->m_regA |= lobit << 7;
 
-		cpu->flag_setZero(false);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry(false);
-		cpu->flag_setCarry(lobit);
+		cpu->flag_setAll(false,false,false,lobit);
 	
 		cpu->pc_increment(1);
 		cpu->clock_tick(1);
@@ -153,10 +143,7 @@ namespace fernOpcodes {
 		cpu->m_regA >>= 1;
 		cpu->m_regA |= carry << 7;
 
-		cpu->flag_setZero(false);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry(false);
-		cpu->flag_setCarry(lobit);
+		cpu->flag_setAll(false,false,false,lobit);
 	
 		cpu->pc_increment(1);
 		cpu->clock_tick(1);
@@ -333,137 +320,55 @@ namespace fernOpcodes {
 
 	fern_opcodefn(add_a_imm8) {
 		int opB = cpu->read_pc(1);
-		int res_nyb = (cpu->m_regA & 0xF) + (opB & 0xF);
-		int result = static_cast<int>(cpu->m_regA) + opB;
-		cpu->m_regA = result;
-		cpu->flag_setZero((result & 0xFF) == 0);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
-		cpu->flag_setCarry((result & 0x100) != 0);
+		cpu->flag_syncCompareAdd(cpu->m_regA,opB);
+		cpu->m_regA = static_cast<int>(cpu->m_regA) + opB;
 		
 		cpu->pc_increment(2);
 		cpu->clock_tick(2);
 	}
 	fern_opcodefn(adc_a_imm8) {
 		int opB = cpu->read_pc(1) + cpu->flag_carry();
-		int res_nyb = (cpu->m_regA & 0xF) + (opB & 0xF);
-		int result = static_cast<int>(cpu->m_regA) + opB;
-		cpu->m_regA = result;
-		cpu->flag_setZero((result & 0xFF) == 0);
-		cpu->flag_setSubtract(false);
-		cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
-		cpu->flag_setCarry(result > 255);
+		cpu->flag_syncCompareAdd(cpu->m_regA,opB);
+		cpu->m_regA = static_cast<int>(cpu->m_regA) + opB;
 		
 		cpu->pc_increment(2);
 		cpu->clock_tick(2);
 	}
 	fern_opcodefn(sub_a_imm8) {
 		int opB = cpu->read_pc(1);
-		int res_nyb = (cpu->m_regA & 0xF) - (opB & 0xF);
-		int result = static_cast<int>(cpu->m_regA) - opB;
-		cpu->flag_setCarry(opB > cpu->m_regA);
-		cpu->m_regA = result;
-		cpu->flag_setZero((result & 0xFF) == 0);
-		cpu->flag_setSubtract(true);
-		cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
+		cpu->flag_syncCompare(cpu->m_regA,opB);
+		cpu->m_regA = static_cast<int>(cpu->m_regA) - opB;
 		
 		cpu->pc_increment(2);
 		cpu->clock_tick(2);
 	}
 	fern_opcodefn(sbc_a_imm8) {
 		int opB = cpu->read_pc(1) + cpu->flag_carry();
-		int res_nyb = (cpu->m_regA & 0xF) - (opB & 0xF);
-		int result = static_cast<int>(cpu->m_regA) - opB;
-		cpu->flag_setCarry(opB > cpu->m_regA);
-		cpu->m_regA = result;
-		cpu->flag_setZero((result & 0xFF) == 0);
-		cpu->flag_setSubtract(true);
-		cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
+		cpu->flag_syncCompare(cpu->m_regA,opB);
+		cpu->m_regA = static_cast<int>(cpu->m_regA) - opB;
 		
 		cpu->pc_increment(2);
 		cpu->clock_tick(2);
 	}
-	fern_opcodepfxfn(addadc) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
+	fern_opcodegrpfn(addadc) {
+		int opB = grp_read<register_id>(cpu,emu);
+		if constexpr(opcode_mode) opB += cpu->flag_carry(); // adc
 
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
-
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) { // add
-			int res_nyb = (cpu->m_regA & 0xF) + (cur_reg() & 0xF);
-			int result = static_cast<int>(cpu->m_regA) + cur_reg();
-			cpu->m_regA = result;
-			cpu->flag_setZero((result & 0xFF) == 0);
-			cpu->flag_setSubtract(false);
-			cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
-			cpu->flag_setCarry(result > 255);
-		} else { // adc
-			int op2 = cur_reg() + cpu->flag_carry();
-			int res_nyb = (cpu->m_regA & 0xF) + (op2 & 0xF);
-			int result = static_cast<int>(cpu->m_regA) + op2;
-			cpu->m_regA = result;
-			cpu->flag_setZero((result & 0xFF) == 0);
-			cpu->flag_setSubtract(false);
-			cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
-			cpu->flag_setCarry(result > 255);
-		}
+		cpu->flag_syncCompareAdd(cpu->m_regA,opB);
+		cpu->m_regA = static_cast<int>(cpu->m_regA) + opB;
 
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
+		cpu->pc_increment(1);
+		cpu->clock_tick(grp_ticks<register_id>);
 	}
-	fern_opcodepfxfn(subsbc) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
+	fern_opcodegrpfn(subsbc) {
+		int opB = grp_read<register_id>(cpu,emu);
+		if constexpr(opcode_mode) opB += cpu->flag_carry(); // sbc
 
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
-
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) {
-			int res_nyb = (cpu->m_regA & 0xF) - (cur_reg() & 0xF);
-			int result = static_cast<int>(cpu->m_regA) - cur_reg();
-			cpu->flag_setCarry(cur_reg() > cpu->m_regA);
-			cpu->m_regA = result;
-			cpu->flag_setZero((result & 0xFF) == 0);
-			cpu->flag_setSubtract(true);
-			cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
-		} else {
-			int op2 = cur_reg() + cpu->flag_carry();
-			int res_nyb = (cpu->m_regA & 0xF) - (op2 & 0xF);
-			int result = static_cast<int>(cpu->m_regA) - op2;
-			cpu->flag_setCarry(op2 > cpu->m_regA);
-			cpu->m_regA = result;
-			cpu->flag_setZero((result & 0xFF) == 0);
-			cpu->flag_setSubtract(true);
-			cpu->flag_setHalfcarry((res_nyb & 0x10) == 0x10);
-		}
+		cpu->flag_syncCompare(cpu->m_regA,opB);
+		cpu->m_regA = static_cast<int>(cpu->m_regA) - opB;
 
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
+		cpu->pc_increment(1);
+		cpu->clock_tick(grp_ticks<register_id>);
 	}
 
 	// loads
@@ -503,128 +408,51 @@ namespace fernOpcodes {
 		cpu->clock_tick(2);
 	}
 
-	fern_opcodepfxfn(ldbldc) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
-
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
-		
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) {
-			cpu->m_regB = cur_reg();
+	fern_opcodegrpfn(ldbldc) {
+		if constexpr(!opcode_mode) {
+			cpu->m_regB = grp_read<register_id>(cpu,emu);
 		} else {
-			cpu->m_regC = cur_reg();
+			cpu->m_regC = grp_read<register_id>(cpu,emu);
 		}
 
-		/*if(register_id == 0) {
-			std::puts("debug break!");
-			emu->debug_set(true);
-		}*/
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
+		cpu->pc_increment(1);
+		cpu->clock_tick(grp_ticks<register_id>);
 	}
-	fern_opcodepfxfn(lddlde) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
-
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
-		
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) {
-			cpu->m_regD = cur_reg();
+	fern_opcodegrpfn(lddlde) {
+		if constexpr(!opcode_mode) {
+			cpu->m_regD = grp_read<register_id>(cpu,emu);
 		} else {
-			cpu->m_regE = cur_reg();
+			cpu->m_regE = grp_read<register_id>(cpu,emu);
 		}
 
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
+		cpu->pc_increment(1);
+		cpu->clock_tick(grp_ticks<register_id>);
 	}
-	fern_opcodepfxfn(ldhldl) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
-
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
-		
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) {
-			cpu->m_regH = cur_reg();
+	fern_opcodegrpfn(ldhldl) {
+		if constexpr(!opcode_mode) {
+			cpu->m_regH = grp_read<register_id>(cpu,emu);
 		} else {
-			cpu->m_regL = cur_reg();
+			cpu->m_regL = grp_read<register_id>(cpu,emu);
 		}
 
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
+		cpu->pc_increment(1);
+		cpu->clock_tick(grp_ticks<register_id>);
 	}
-	fern_opcodepfxfn(ldhllda) {
-		auto uses_hl = fern::RegisterName::is_hldata(register_id);
-		if(uses_hl && opcode_mode == 0) {
-			std::puts("unimplemented: HALT");
-			cpu->print_status();
-			std::exit(-1);
-		}
-		
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
-
-		auto cur_reg = [&]() {
-			return *reg_ptrs[register_id];
-		};
-		
-		int clock_ticks = uses_hl ? 2 : 1;
-		int pc_offset = 1;
-
-		if(!opcode_mode) {
-			emu->mem.write(cpu->reg_hl(),cur_reg());
-			clock_ticks = 2;
+	fern_opcodegrpfn(ldhllda) {
+		if constexpr(!opcode_mode) {
+			if constexpr(fern::RegisterName::is_hldata(register_id)) {
+				std::puts("unimplemented: HALT");
+				cpu->print_status();
+				std::exit(-1);
+			}
+			emu->mem.write(cpu->reg_hl(),grp_read<register_id>(cpu,emu));
+			cpu->pc_increment(1);
+			cpu->clock_tick(2);
 		} else {
-			cpu->m_regA = cur_reg();
+			cpu->m_regA = grp_read<register_id>(cpu,emu);
+			cpu->pc_increment(1);
+			cpu->clock_tick(grp_ticks<register_id>);
 		}
-
-		cpu->pc_increment(pc_offset);
-		cpu->clock_tick(clock_ticks);
 	}
 
 	fern_opcodefn(ld_bc_imm16) {
@@ -1022,7 +850,7 @@ namespace fernOpcodes {
 		cpu->clock_tick(3);
 	}
 	fern_opcodefn(pop_af) {
-		cpu->m_regF = cpu->stack_pop8() & 0xF0;
+		cpu->f_set(cpu->stack_pop8() & 0xF0);
 		cpu->m_regA = cpu->stack_pop8();
 		cpu->pc_increment(1);
 		cpu->clock_tick(3);
@@ -1050,179 +878,88 @@ namespace fernOpcodes {
 	}
 
 	// CB prefix
-	fern_opcodefn(prefix) {
-		int prefix_operand = cpu->read_pc(1);
-		int reg_id = prefix_operand & 7;
-		int oper_id = prefix_operand >> 4;
-		int oper_mode = (prefix_operand >> 3) & 1;
-		
-		auto uses_hl = fern::RegisterName::is_hldata(reg_id);
-		uint8_t cur_hldat = 0;
-		if(uses_hl) cur_hldat = emu->mem.read(cpu->reg_hl());
-		
-		uint8_t* reg_ptrs[8] = {
-			&cpu->m_regB,&cpu->m_regC,
-			&cpu->m_regD,&cpu->m_regE,
-			&cpu->m_regH,&cpu->m_regL,
-			&cur_hldat,&cpu->m_regA,
-		};
-
-		auto cur_reg = [&]() {
-			return *reg_ptrs[reg_id];
-		};
-		auto reg_write = [&](uint8_t data) {
-			*reg_ptrs[reg_id] = data;
-		};
-
-		int clock_ticks = -1;
-		bool writeback_hldat = false;
-
-		// operation fetching
-		switch(oper_id) {
-			case 0x00: { // RLC/RRC
-				int result = 0;
-				bool carry = false;
-				if(oper_mode == 0) {
-					result = (cur_reg()<<1) | (cur_reg()>>7);
-					carry = cur_reg() >> 7;
+	// every CB opcode gets its own instantiation, with the operation, bit
+	// and operand all decoded at compile time.
+	fern_opcodecbfn(cb) {
+		constexpr int reg_id = cb_opcode & 7;
+		constexpr int oper_mode = (cb_opcode >> 3) & 1;
+		constexpr int bit_idx = (cb_opcode >> 3) & 7;
+		constexpr bool uses_hl = fern::RegisterName::is_hldata(reg_id);
+		const int operand = grp_read<reg_id>(cpu,emu);
+
+		if constexpr(cb_opcode < 0x40) {
+			int result = 0;
+			bool carry = false;
+			if constexpr(cb_opcode < 0x10) { // RLC/RRC
+				if constexpr(oper_mode == 0) {
+					result = (operand<<1) | (operand>>7);
+					carry = operand >> 7;
 				} else {
-					result = (cur_reg()>>1) | (cur_reg()<<7);
-					carry = cur_reg()&1;
+					result = (operand>>1) | (operand<<7);
+					carry = operand&1;
 				}
-				
-				cpu->flag_setZero(result == 0);
-				cpu->flag_setSubtract(false);
-				cpu->flag_setHalfcarry(false);
-				cpu->flag_setCarry(carry);
-				reg_write(result);
-
-				clock_ticks = uses_hl ? 4 : 2;
-				writeback_hldat = uses_hl;
-				break;
-			}
-			case 0x01: { // RL/RR
-				int result = 0;
-				bool carry = false;
-				if(oper_mode == 0) {
-					result = (cur_reg()<<1) | cpu->flag_carry();
-					carry = cur_reg() >> 7;
+			} else if constexpr(cb_opcode < 0x20) { // RL/RR
+				if constexpr(oper_mode == 0) {
+					result = (operand<<1) | cpu->flag_carry();
+					carry = operand >> 7;
 				} else {
-					result = (cur_reg()>>1) | (cpu->flag_carry()<<7);
-					carry = cur_reg()&1;
+					result = (operand>>1) | (cpu->flag_carry()<<7);
+					carry = operand&1;
 				}
-				
-				cpu->flag_setZero(result == 0);
-				cpu->flag_setSubtract(false);
-				cpu->flag_setHalfcarry(false);
-				cpu->flag_setCarry(carry);
-				reg_write(result);
-
-				clock_ticks = uses_hl ? 4 : 2;
-				writeback_hldat = uses_hl;
-				break;
-			}
-			case 0x02: { // SLA/SRA
-				int result = 0;
-				bool carry = false;
-				if(oper_mode == 0) {
-					result = cur_reg() << 1;
-					carry = cur_reg() >> 7;
+			} else if constexpr(cb_opcode < 0x30) { // SLA/SRA
+				if constexpr(oper_mode == 0) {
+					result = operand << 1;
+					carry = operand >> 7;
 				} else {
-					result = (cur_reg()>>1) | (cur_reg()&0x80);
-					carry = cur_reg()&1;
+					result = (operand>>1) | (operand&0x80);
+					carry = operand&1;
 				}
-				
-				cpu->flag_setZero(result == 0);
-				cpu->flag_setSubtract(false);
-				cpu->flag_setHalfcarry(false);
-				cpu->flag_setCarry(carry);
-				reg_write(result);
-
-				clock_ticks = uses_hl ? 4 : 2;
-				writeback_hldat = uses_hl;
-				break;
-			}
-			case 0x3: { // SWAP/SRL
-				if(oper_mode == 0) {
-					int lo = cur_reg() & 0xF;
-					int hi = cur_reg() >> 4;
-					reg_write((lo<<4) | hi);
-					cpu->flag_setZero(cur_reg() == 0);
-					cpu->flag_setSubtract(false);
-					cpu->flag_setHalfcarry(false);
-					cpu->flag_setCarry(false);
+			} else { // SWAP/SRL
+				if constexpr(oper_mode == 0) {
+					result = ((operand & 0xF)<<4) | (operand>>4);
 				} else {
-					int lo = cur_reg() & 1;
-					reg_write(cur_reg() >> 1);
-					cpu->flag_setZero(cur_reg() == 0);
-					cpu->flag_setSubtract(false);
-					cpu->flag_setHalfcarry(false);
-					cpu->flag_setCarry(lo);
+					result = operand >> 1;
+					carry = operand&1;
 				}
-				clock_ticks = uses_hl ? 4 : 2;
-				writeback_hldat = uses_hl;
-				break;
-			}
-			// BIT --------------------------------------@/
-			case 0x4:
-			case 0x5:
-			case 0x6:
-			case 0x7: {
-				int bit_idx = (prefix_operand - 0x40) >> 3;
-				bool flag = (cur_reg() >> bit_idx)&1;
-				cpu->flag_setZero(flag == 0);
-				cpu->flag_setSubtract(false);
-				cpu->flag_setHalfcarry(true);
-
-				clock_ticks = uses_hl ? 3 : 2;
-				break;
-			}
-			// RES --------------------------------------@/
-			case 0x8:
-			case 0x9:
-			case 0xA:
-			case 0xB: {
-				int bit_idx = (prefix_operand - 0x80) >> 3;
-				reg_write(cur_reg() & (0xFF ^ (1<<bit_idx)));
-
-				writeback_hldat = uses_hl;
-				clock_ticks = uses_hl ? 4 : 2;
-				break;
 			}
+			cpu->flag_setAll(result == 0,false,false,carry);
+			grp_write<reg_id>(cpu,emu,result);
 
-			// SET --------------------------------------@/
-			case 0xC:
-			case 0xD:
-			case 0xE:
-			case 0xF: {
-				int bit_idx = (prefix_operand - 0xC0) >> 3;
-				reg_write(cur_reg() | (1<<bit_idx));
-
-				writeback_hldat = uses_hl;
-				clock_ticks = uses_hl ? 4 : 2;
-				break;
-			}
-
-			default: {
-				std::printf("unimplemented prefix op (%02Xh)\n",oper_id);
-				cpu->print_status();
-				std::exit(-1);
-			}
+			cpu->pc_increment(2);
+			cpu->clock_tick(uses_hl ? 4 : 2);
 		}
+		// BIT --------------------------------------@/
+		else if constexpr(cb_opcode < 0x80) {
+			bool flag = (operand >> bit_idx)&1;
+			cpu->flag_setZero(flag == 0);
+			cpu->flag_setSubtract(false);
+			cpu->flag_setHalfcarry(true);
 
-		// write back to HL pointer, if needed
-		if(writeback_hldat) {
-			emu->mem.write(cpu->reg_hl(),cur_hldat);
+			cpu->pc_increment(2);
+			cpu->clock_tick(uses_hl ? 3 : 2);
 		}
+		// RES/SET ----------------------------------@/
+		else {
+			if constexpr(cb_opcode < 0xC0) {
+				grp_write<reg_id>(cpu,emu,operand & (0xFF ^ (1<<bit_idx)));
+			} else {
+				grp_write<reg_id>(cpu,emu,operand | (1<<bit_idx));
+			}
 
-		if(clock_ticks == -1) {
-			std::puts("prefix opcode error: incorrect clockincrement!");
-			cpu->print_status();
-			std::exit(-1);
+			cpu->pc_increment(2);
+			cpu->clock_tick(uses_hl ? 4 : 2);
 		}
+	}
+	template<std::size_t... cb_opcodes>
+	constexpr auto cb_tablegen(std::index_sequence<cb_opcodes...>) {
+		return std::array<fern::CCPUInstrFn,0x100> {
+			INSTRFN_NAME(cb)<cb_opcodes>...
+		};
+	}
+	constexpr auto cb_table = cb_tablegen(std::make_index_sequence<0x100>());
 
-		cpu->pc_increment(2);
-		cpu->clock_tick(clock_ticks);
+	fern_opcodefn(prefix) {
+		cb_table[cpu->read_pc(1)](cpu,emu);
 	}
 
 	// misc
@@ -1236,11 +973,6 @@ namespace fernOpcodes {
 		cpu->print_status();
 		std::exit(-1);
 	}
-	fern_opcodepfxfn(unimplemented_pfx) {
-		std::printf("unimplemented instruction prefix (%02Xh)\n",cpu->m_curopcode);
-		cpu->print_status();
-		std::exit(-1);
-	}
 
 	fern_opcodefn(cpl) {
 		cpu->m_regA = ~cpu->m_regA;
@@ -1299,6 +1031,7 @@ namespace fernOpcodes {
 	}
 	fern_opcodefn(ei) {
 		cpu->m_should_enableIME = true;
+		cpu->clock_reschedule();
 		cpu->pc_increment(1);
 		cpu->clock_tick(1);
 	}
@@ -1307,9 +1040,7 @@ namespace fernOpcodes {
 		cpu->pc_increment(1);
 
 		cpu->halt_waitStart();
-		while(cpu->halt_isWaiting()) {
-			cpu->clock_tick(1);
-		}
+		cpu->halt_run();
 	}
 	fern_opcodefn(nop) {
 		cpu->pc_increment(1);
@@ -1322,7 +1053,7 @@ namespace fernOpcodes {
 				emu->mem.m_io.m_KEY1 ^= BIT(7);
 				emu->mem.m_io.m_KEY1 &= BIT(7);
 			}
-			cpu->m_speedDoubled = (emu->mem.m_io.m_KEY1 >> 7);
+			cpu->speed_set(emu->mem.m_io.m_KEY1 >> 7);
 		} else {
 			std::puts("error: stop during normal DMG use?");
 			cpu->print_status();
@@ -1335,6 +1066,13 @@ namespace fernOpcodes {
 
 namespace fern {
 	CCPU::CCPU() {
+#ifdef FERN_JIT
+		m_jitBuffer = nullptr;
+		m_jitEnabled = true;
+#endif
+#ifdef FERN_PROFILE
+		m_profileEnabled = false;
+#endif
 		// setup instruction table ----------------------@/
 		opcode_clear();
 		
@@ -1351,8 +1089,8 @@ namespace fern {
 		// bitwise
 		opcode_set(0xE6,CCPUInstr(INSTRFN_NAME(and_a_imm8),"and a,imm8"));
 		opcode_set(0xF6,CCPUInstr(INSTRFN_NAME(or_a_imm8),"or a,imm8"));
-		opcode_setPrefix(0xA,CCPUInstrPfx(INSTRFN_NAME(andxor),"and a,xx/xor a,xx"));
-		opcode_setPrefix(0xB,CCPUInstrPfx(INSTRFN_NAME(orcp),"or a,xx/cp a,xx"));
+		opcode_setGroup(0xA0,INSTRFN_GROUP(andxor),"and a,%s","xor a,%s");
+		opcode_setGroup(0xB0,INSTRFN_GROUP(orcp),"or a,%s","cp a,%s");
 
 		opcode_set(0xEE,CCPUInstr(INSTRFN_NAME(xor_a_imm8),"xor a,imm8"));
 		
@@ -1406,8 +1144,8 @@ namespace fern {
 		opcode_set(0xCE,CCPUInstr(INSTRFN_NAME(adc_a_imm8),"adc a,imm8"));
 		opcode_set(0xD6,CCPUInstr(INSTRFN_NAME(sub_a_imm8),"sub a,imm8"));
 		opcode_set(0xDE,CCPUInstr(INSTRFN_NAME(sbc_a_imm8),"sbc a,imm8"));
-		opcode_setPrefix(0x8,CCPUInstrPfx(INSTRFN_NAME(addadc),"add a,xx/adc a,xx"));
-		opcode_setPrefix(0x9,CCPUInstrPfx(INSTRFN_NAME(subsbc),"sub a,xx/sbc a,xx"));
+		opcode_setGroup(0x80,INSTRFN_GROUP(addadc),"add a,%s","adc a,%s");
+		opcode_setGroup(0x90,INSTRFN_GROUP(subsbc),"sub a,%s","sbc a,%s");
 
 		// loads
 		opcode_set(0x06,CCPUInstr(INSTRFN_NAME(ld_b_imm8),"ld b, imm8"));
@@ -1418,10 +1156,12 @@ namespace fern {
 		opcode_set(0x2E,CCPUInstr(INSTRFN_NAME(ld_l_imm8),"ld l, imm8"));
 		opcode_set(0x3E,CCPUInstr(INSTRFN_NAME(ld_a_imm8),"ld a, imm8"));
 		
-		opcode_setPrefix(0x4,CCPUInstrPfx(INSTRFN_NAME(ldbldc),"ld b,xx/lda c,xx"));
-		opcode_setPrefix(0x5,CCPUInstrPfx(INSTRFN_NAME(lddlde),"ld d,xx/lda e,xx"));
-		opcode_setPrefix(0x6,CCPUInstrPfx(INSTRFN_NAME(ldhldl),"ld h,xx/lda l,xx"));
-		opcode_setPrefix(0x7,CCPUInstrPfx(INSTRFN_NAME(ldhllda),"ld [hl],xx/lda a,xx"));
+		opcode_setGroup(0x40,INSTRFN_GROUP(ldbldc),"ld b,%s","ld c,%s");
+		opcode_setGroup(0x50,INSTRFN_GROUP(lddlde),"ld d,%s","ld e,%s");
+		opcode_setGroup(0x60,INSTRFN_GROUP(ldhldl),"ld h,%s","ld l,%s");
+		std::array<CCPUInstrFn,16> ldhllda_fns = INSTRFN_GROUP(ldhllda);
+		ldhllda_fns[RegisterName::HLData] = nullptr; // $76 is halt
+		opcode_setGroup(0x70,ldhllda_fns,"ld [hl],%s","ld a,%s");
 		
 		opcode_set(0x01,CCPUInstr(INSTRFN_NAME(ld_bc_imm16),"ld bc, imm16"));
 		opcode_set(0x11,CCPUInstr(INSTRFN_NAME(ld_de_imm16),"ld de, imm16"));
@@ -1522,7 +1262,7 @@ namespace fern {
 		m_regIME = false;
 		m_haltwaiting = false;
 
-		m_regF = 0;
+		f_set(0);
 		m_regB = 0x00;
 		m_regC = 0x13;
 		m_regD = 0x00;
@@ -1534,22 +1274,36 @@ namespace fern {
 		m_SP = 0xFFFE;
 
 		dotclock_reset(); // start in mode 2
-		m_clockWaiting = false;
-		m_clockWaitBuffer = std::stack<int>();
+		m_clockCycles = 0;
+		m_clockSynced = 0;
+		m_clockUpdates = 0;
+		m_clockEvents.fill(CLOCKEVENT_NEVER);
+		clock_reschedule();
+
+		m_runLimit = CLOCKEVENT_NEVER;
+		m_runToFrame = false;
+		m_runStop = false;
+		m_frameDone = false;
 
 		m_lycCooldown = false;
 
-		m_timerctrDiv = 0;
+		m_timerDivStamp = 0;
+		m_timerSynced = 0;
 		m_timerctrMain = 0;
 
 		m_curopcode_ptr = nullptr;
+		idle_reset();
+		profile_reset();
 
 		// setup instruction history
-		m_instrhistory = std::deque<CInstrHistoryData>();
-		std::vector<int> opcodedata = { 0xFF };
-		for(int i=0; i<4; i++) {
-			m_instrhistory.push_back(CInstrHistoryData());
-		}
+#ifndef FERN_NO_HISTORY
+		m_instrhistory.fill({});
+		m_instrhistoryPos = 0;
+#endif
+#ifdef FERN_CPUCORE_CACHED
+		blockcache_clear();
+#endif
+		break_reset();
 	}
 
 	auto CCPU::dotclock_reset() -> void {
@@ -1559,27 +1313,40 @@ namespace fern {
 	}
 
 	// instruction history ------------------------------@/
+	// entries are written into a ring buffer; index 0 is the newest one.
+#ifndef FERN_NO_HISTORY
 	auto CCPU::instrhistory_get(int index) -> CInstrHistoryData {
-		return m_instrhistory.at(m_instrhistory.size()-1-index);
-	}
-	auto CCPU::instrhistory_push(int bank, int pc, const std::vector<int>& opcodedata) -> void {
-		auto instr = fern::CInstrHistoryData(bank,pc,opcodedata);
-		m_instrhistory.push_back(instr);
-		m_instrhistory.pop_front();
+		const uint32_t mask = INSTRHISTORY_DEPTH - 1;
+		return m_instrhistory[(m_instrhistoryPos - 1 - index) & mask];
 	}
 	auto CCPU::instrhistory_pushCurrent() -> void {
-		// get rom bank
-		int bank = emu()->mem.rombank_current();
-		int pc = m_PC;
-		std::vector<int> opcode_data = { 0xFF };
-		instrhistory_push(bank,pc,opcode_data);
+		// bank's latched by CMem on mapper writes, so no mapper call here
+		instrhistory_push(emu()->mem.m_rombankLatched,m_PC);
+	}
+#else
+	auto CCPU::instrhistory_get(int index) -> CInstrHistoryData { return {}; }
+	auto CCPU::instrhistory_pushCurrent() -> void {}
+#endif
+	// the bank that's switched in at pc (code or data), numbered like
+	// RGBDS does in .sym files. breakpoints, watchpoints, the profiler and
+	// the block cache all go by this.
+	auto CCPU::code_bank(int pc) -> int {
+		auto& mem = m_emu->mem;
+		if(pc >= 0x4000 && pc < 0x8000) {
+			return mem.m_rombankLatched;
+		} else if(pc >= 0x8000 && pc < 0xA000) {
+			return mem.m_io.m_VBK;
+		} else if(pc >= 0xA000 && pc < 0xC000) {
+			const int bank = std::visit([](auto& mapper) { return mapper.sram_bank(); },mem.m_mapper);
+			return std::max(bank,0);
+		} else if(pc >= 0xD000 && pc < 0xE000) {
+			return (m_emu->cgb_enabled() && mem.m_io.m_SVBK != 0) ? mem.m_io.m_SVBK : 1;
+		}
+		return 0;
 	}
 
 	// opcode setting -----------------------------------@/
 	auto CCPU::opcode_clear() -> void {
-		for(int i=0; i<16; i++) {
-			opcode_setPrefix(i,CCPUInstrPfx(INSTRFN_NAME(unimplemented_pfx),"unimplemented"));
-		}
 		for(int i=0; i<256; i++) {
 			opcode_setRaw(i,CCPUInstr(INSTRFN_NAME(unimplemented),"unimplemented"));
 		}
@@ -1602,8 +1369,14 @@ namespace fern {
 		}
 		opcode = instr;
 	}
-	auto CCPU::opcode_setPrefix(std::size_t index,CCPUInstrPfx instr) -> void {
-		m_opcodetable_pfx.at(index) = instr;
+	auto CCPU::opcode_setGroup(std::size_t index,const std::array<CCPUInstrFn,16>& fns,const char* name_lo,const char* name_hi) -> void {
+		const char* reg_names[8] = { "b","c","d","e","h","l","[hl]","a" };
+		for(int i=0; i<16; i++) {
+			if(!fns[i]) continue;
+			char instr_name[32];
+			std::snprintf(instr_name,sizeof(instr_name),(i<8) ? name_lo : name_hi,reg_names[i&7]);
+			opcode_set(index + i,CCPUInstr(fns[i],instr_name));
+		}
 	}
 
 	auto CCPU::print_status(bool instr_history) -> void {
@@ -1625,7 +1398,7 @@ namespace fern {
 
 		auto& mem = emu()->mem;
 		auto& io = mem.m_io;
-		const auto rombank = mem.rombank_current();
+		const auto rombank = mem.m_rombankLatched;
 		const int ly = io.m_LY;
 		std::printf("last opcode: %s\n",m_curopcode_ptr->name.c_str());
 		std::printf("CPU: %04Xh[+%4Xh]\n",m_PC,m_SP);
@@ -1635,16 +1408,101 @@ namespace fern {
 		std::printf("\tDE:   $%04X IE:   %s\n",reg_de(),tostr_bin(io.m_IE).c_str());
 		std::printf("\tHL:   $%04X IF:   %s\n",reg_hl(),tostr_bin(io.m_IF).c_str());
 		std::printf("\tSTAT: $%04X IME:  %d\n",io.m_STAT,m_regIME);
-		std::printf("\tDC:    %4d DIV:   $%02X\n",m_dotclock,io.m_DIV);
+		std::printf("\tDC:    %4d DIV:   $%02X\n",m_dotclock,timer_div());
 
 		if(instr_history) {
-			for(int i=0; i<m_instrhistory.size(); i++) {
+			for(int i=0; i<instrhistory_size(); i++) {
 				const auto hisdata = instrhistory_get(i);
 				std::printf("\thistory[-%d]: pc=$%02X:%04X\n",i,hisdata.bank,hisdata.pc);
 			}
 		}
 	}
 	
+	// flags --------------------------------------------@/
+	// the 8-bit ALU producers. without FERN_LAZY_FLAGS these set F right
+	// away, otherwise they just record the op for flag_materializeOp().
+#ifdef FERN_LAZY_FLAGS
+	auto CCPU::flag_syncAnd(int opA,int opB) -> void {
+		m_flagOp = CPUFlagOp::logic_and;
+		m_flagOpA = (opA & opB) & 0xFF;
+	}
+	auto CCPU::flag_syncOr(int opA,int opB) -> void {
+		m_flagOp = CPUFlagOp::logic_or;
+		m_flagOpA = (opA | opB) & 0xFF;
+	}
+	auto CCPU::flag_syncXor(int opA,int opB) -> void {
+		m_flagOp = CPUFlagOp::logic_or;
+		m_flagOpA = (opA ^ opB) & 0xFF;
+	}
+	auto CCPU::flag_syncCompare(int opA,int opB) -> void {
+		m_flagOp = CPUFlagOp::sub;
+		m_flagOpA = opA;
+		m_flagOpB = opB;
+	}
+	auto CCPU::flag_syncCompareAdd(int opA,int opB) -> void {
+		m_flagOp = CPUFlagOp::add;
+		m_flagOpA = opA;
+		m_flagOpB = opB;
+	}
+	// inc/dec keep the old carry, so that has to be worked out first.
+	auto CCPU::flag_syncCompareInc(int operand) -> void {
+		flag_materialize();
+		m_flagOp = CPUFlagOp::inc;
+		m_flagOpA = operand;
+	}
+	auto CCPU::flag_syncCompareDec(int operand) -> void {
+		flag_materialize();
+		m_flagOp = CPUFlagOp::dec;
+		m_flagOpA = operand;
+	}
+	auto CCPU::flag_materializeOp() -> void {
+		const int opA = m_flagOpA;
+		const int opB = m_flagOpB;
+		switch(m_flagOp) {
+			case CPUFlagOp::logic_and: {
+				m_regF = ((opA == 0)<<7) | (1<<5);
+				break;
+			}
+			case CPUFlagOp::logic_or: {
+				m_regF = (opA == 0)<<7;
+				break;
+			}
+			case CPUFlagOp::add: {
+				auto result = (opA + opB);
+				auto res_4b = (opA & 0xF) + (opB & 0xF);
+				m_regF = (((result & 0xFF) == 0)<<7)
+					| (((res_4b & 0x10) == 0x10)<<5)
+					| ((result > 255)<<4);
+				break;
+			}
+			case CPUFlagOp::sub: {
+				auto result = (opA - opB);
+				auto res_4b = (opA & 0xF) - (opB & 0xF);
+				m_regF = (((result & 0xFF) == 0)<<7) | (1<<6)
+					| (((res_4b & 0x10) == 0x10)<<5)
+					| ((opB > opA)<<4);
+				break;
+			}
+			case CPUFlagOp::inc: {
+				auto result = (opA + 1) & 0xFF;
+				auto res_4b = (opA & 0xF) + 1;
+				m_regF = ((result == 0)<<7)
+					| (((res_4b & 0x10) == 0x10)<<5)
+					| (m_regF & 0x10);
+				break;
+			}
+			case CPUFlagOp::dec: {
+				auto result = (opA - 1) & 0xFF;
+				auto res_4b = (opA & 0xF) - 1;
+				m_regF = ((result == 0)<<7) | (1<<6)
+					| (((res_4b & 0x10) == 0x10)<<5)
+					| (m_regF & 0x10);
+				break;
+			}
+		}
+		m_flagOp = CPUFlagOp::none;
+	}
+#else
 	auto CCPU::flag_syncAnd(int opA,int opB) -> void {
 		auto result = (opA & opB);
 		flag_setZero(result == 0);
@@ -1652,12 +1510,19 @@ namespace fern {
 		flag_setHalfcarry(true);
 		flag_setCarry(false);
 	}
-	auto CCPU::flag_syncAdd16(uint32_t opA, uint32_t opB) -> void {
-		auto result = (opA + opB);
-		auto res_4b = (opA & 0xFFF) + (opB & 0xFFF);
+	auto CCPU::flag_syncOr(int opA,int opB) -> void {
+		auto result = (opA | opB) & 0xFF;
+		flag_setZero(result == 0);
 		flag_setSubtract(false);
-		flag_setHalfcarry((res_4b & 0x1000) == 0x1000);
-		flag_setCarry(result > 0xFFFF);
+		flag_setHalfcarry(false);
+		flag_setCarry(false);
+	}
+	auto CCPU::flag_syncXor(int opA,int opB) -> void {
+		auto result = (opA ^ opB) & 0xFF;
+		flag_setZero(result == 0);
+		flag_setSubtract(false);
+		flag_setHalfcarry(false);
+		flag_setCarry(false);
 	}
 	auto CCPU::flag_syncCompare(int opA,int opB) -> void {
 		auto result = (opA - opB);
@@ -1667,6 +1532,14 @@ namespace fern {
 		flag_setHalfcarry((res_4b & 0x10) == 0x10);
 		flag_setCarry(opB > opA);
 	}
+	auto CCPU::flag_syncCompareAdd(int opA,int opB) -> void {
+		auto result = (opA + opB);
+		auto res_4b = (opA & 0xF) + (opB & 0xF);
+		flag_setZero((result & 0xFF) == 0);
+		flag_setSubtract(false);
+		flag_setHalfcarry((res_4b & 0x10) == 0x10);
+		flag_setCarry(result > 255);
+	}
 	auto CCPU::flag_syncCompareInc(int operand) -> void {
 		auto result = (operand + 1) & 0xFF;
 		auto res_4b = (operand & 0xF) + (1 & 0xF);
@@ -1681,9 +1554,20 @@ namespace fern {
 		flag_setSubtract(true);
 		flag_setHalfcarry((res_4b & 0x10) == 0x10);
 	}
+#endif
+	auto CCPU::flag_syncAdd16(uint32_t opA, uint32_t opB) -> void {
+		auto result = (opA + opB);
+		auto res_4b = (opA & 0xFFF) + (opB & 0xFFF);
+		flag_setSubtract(false);
+		flag_setHalfcarry((res_4b & 0x1000) == 0x1000);
+		flag_setCarry(result > 0xFFFF);
+	}
 	
 	// memory access ------------------------------------@/
 	auto CCPU::read_pc(int offset) -> uint32_t {
+#ifdef FERN_CPUCORE_CACHED
+		if(m_pcbytes) return m_pcbytes[offset];
+#endif
 		return m_emu->mem.read(m_PC + offset);
 	}
 	auto CCPU::read_pc16(int offset) -> uint32_t {
@@ -1724,17 +1608,64 @@ namespace fern {
 		retaddr &= 0xFFFF;
 		stack_push16(retaddr);
 		m_PC = addr;
+		profile_call(addr,m_SP);
 	}
 	auto CCPU::calreturn(bool enable_intr) -> void {
 		if(enable_intr) {
 			m_PC = stack_pop16();
 			m_should_enableIME = true;
+			clock_reschedule();
 		} else {
 			m_PC = stack_pop16();
 		}
+		profile_return(m_SP);
+	}
+
+#if !defined(FERN_CPUCORE_THREADED) && !defined(FERN_CPUCORE_CACHED)
+	// table core: runs each instruction through step(). the threaded and
+	// cached cores (cpu_threaded.cpp, cpu_cached.cpp) replace this.
+	auto CCPU::run(int instr_count) -> void {
+		int instrs_left = instr_count;
+		while(instrs_left > 0 && !m_runStop) {
+			const int pc = m_PC;
+			if(break_check(pc)) break;
+			step();
+			instrs_left -= 1;
+			if(m_PC <= pc) {
+				instrs_left -= idle_skip(pc,instrs_left);
+			}
+		}
+	}
+#endif
+
+	// runs the clock until cycle_limit, or the start of the next vblank if
+	// to_frame is set. only whole instructions are run, so this can go
+	// over by one. a halt that's still going carries on next time.
+	auto CCPU::run_until(uint64_t cycle_limit,bool to_frame) -> void {
+		m_runLimit = cycle_limit;
+		m_runToFrame = to_frame;
+		m_runStop = m_clockCycles >= cycle_limit;
+		clock_reschedule();
+
+		while(!m_runStop) {
+			if(m_haltwaiting) {
+				halt_run();
+			} else {
+				run(INT_MAX);
+			}
+		}
+
+		m_runLimit = CLOCKEVENT_NEVER;
+		m_runToFrame = false;
+		m_runStop = false;
+		clock_reschedule();
 	}
 
 	auto CCPU::step() -> void {
+		if(m_haltwaiting) {
+			halt_run();
+			return;
+		}
 		if(m_should_enableIME) {
 			m_should_enableIME = false;
 			m_regIME = true;
@@ -1746,26 +1677,20 @@ namespace fern {
 
 	auto CCPU::execute_opcode() -> void {
 		auto opcode_num = m_emu->mem.read(m_PC);
-		int opcode_pfx = opcode_num >> 4;
-		int opcode_mode = (opcode_num>>3) & 1;
 
 		// push opcode
 		instrhistory_pushCurrent();
+		profile_begin(opcode_num,m_PC);
+		trace_begin(m_PC);
 
-		// regular opcode
-		if(m_opcodetable[opcode_num].fn != INSTRFN_NAME(unimplemented)) {
-			auto &opcode = m_opcodetable[opcode_num];
+		opcode_run(opcode_num);
+	}
+	auto CCPU::opcode_run(int opcode_num) -> void {
+		auto &opcode = m_opcodetable[opcode_num];
+		if(opcode.fn != INSTRFN_NAME(unimplemented)) {
 			m_curopcode = opcode_num;
 			m_curopcode_ptr = &opcode;
 			opcode.fn(this,m_emu);
-		}
-		// prefixed opcode
-		 else if(m_opcodetable_pfx[opcode_pfx].fn != INSTRFN_NAME(unimplemented_pfx)) {
-			auto &opcode = m_opcodetable_pfx[opcode_pfx];
-			m_curopcode = opcode_num;
-			m_curopcode_ptr = &opcode;
-			// call function with register ID & mode
-			opcode.fn(this,m_emu,opcode_num & 7,opcode_mode);
 		} else {
 			std::printf("unknown opcode: $%02X\n",opcode_num);
 			print_status();
@@ -1773,188 +1698,297 @@ namespace fern {
 		}
 	}
 
-	auto CCPU::clock_tick(const int cyclecnt) -> void {
-		// if not already waiting, wait, and buffer additional clock ticks
-		if(!m_clockWaiting) {
-			m_clockWaiting = true;
-			m_clockWaitBuffer.push(cyclecnt);
-			
-			while(!m_clockWaitBuffer.empty()) {
-				const auto wait_cycles = m_clockWaitBuffer.top();
-				m_clockWaitBuffer.pop();
+	auto CCPU::speed_set(bool doubled) -> void {
+		// dots per cycle changes, so the PPU has to catch up first
+		clock_catchup();
+		m_speedDoubled = doubled;
+		clock_reschedule();
+	}
+
+	// runs the clock until an interrupt ends the halt. it'd be ticked one
+	// cycle at a time, but nothing can change before the next event, so
+	// this goes straight from one event to the next.
+	// with nothing due (LCD and timer off, outside run_until(), like the
+	// debugger's steps) there's nothing to go to, so it ticks once and
+	// leaves the halt for the next step.
+	auto CCPU::halt_run() -> void {
+		while(m_haltwaiting && !m_runStop) {
+			if(m_clockNextEvent == CLOCKEVENT_NEVER) {
+				clock_tick(1);
+				return;
+			}
+			m_clockCycles = std::max(m_clockCycles + 1,m_clockNextEvent);
+			clock_update();
+		}
+	}
 
-				auto &mem = emu()->mem;
-				// 4 dots per cycle
-				if(mem.m_io.ppu_enabled()) {
-					int mul = speed_doubled() ? 2 : 4;
-				//	int mul = 4;
-					m_dotclock += (wait_cycles*mul);
-				}
+	// timers -------------------------------------------@/
+	// DIV and TIMA aren't ticked, they're worked out from the master clock
+	// when they're read. the only timer event is TIMA overflowing.
+	// DIV goes up every 64 cycles since reset; writing it only clears it.
+	auto CCPU::timer_div() -> int {
+		const uint64_t ticks = (m_clockCycles / 64) - (m_timerDivStamp / 64);
+		return (emu()->mem.m_io.m_DIV + ticks) & 0xFF;
+	}
+	auto CCPU::timer_divReset() -> void {
+		emu()->mem.m_io.m_DIV = 0;
+		m_timerDivStamp = m_clockCycles;
+	}
+	auto CCPU::timer_tima() -> int {
+		timer_catchup();
+		return emu()->mem.m_io.m_TIMA;
+	}
+	auto CCPU::timer_writeTIMA(int data) -> void {
+		timer_catchup();
+		emu()->mem.m_io.m_TIMA = data;
+		clock_reschedule();
+	}
+	// the counter carries over to the new rate. anything past the new
+	// limit is counted off by the next timer_catchup(), before the
+	// overflow's scheduled.
+	auto CCPU::timer_writeTAC(int data) -> void {
+		timer_catchup();
+		emu()->mem.m_io.m_TAC = data;
+		clock_reschedule();
+	}
+	// brings TIMA up to the master clock, reloading it from TMA (and
+	// requesting the interrupt) if it overflows.
+	auto CCPU::timer_catchup() -> void {
+		auto &io = emu()->mem.m_io;
+		const uint64_t elapsed = m_clockCycles - m_timerSynced;
+		m_timerSynced = m_clockCycles;
+		if(!io.timer_enabled()) return;
+
+		const int limit = io.timer_limit();
+		const uint64_t total = m_timerctrMain + elapsed;
+		m_timerctrMain = total % limit;
+		uint64_t increments = total / limit;
+		while(increments > 0) {
+			const uint64_t to_overflow = 0x100 - io.m_TIMA;
+			if(increments < to_overflow) {
+				io.m_TIMA += increments;
+				break;
+			}
+			increments -= to_overflow;
+			io.m_IF |= RFlagIF::timer;
+			io.m_TIMA = io.m_TMA;
+		}
+	}
+
+	// clock & events -----------------------------------@/
+	// brings the dot clock up to the master clock. all of the cycles since
+	// the last catch-up count the same way: anything that would change
+	// that (LCDC, speed switch) calls this first.
+	auto CCPU::clock_catchup() -> void {
+		const int elapsed = m_clockCycles - m_clockSynced;
+		m_clockSynced = m_clockCycles;
 
-				// set current mode
-				// mode 2: OAM scan (0-79?) (no OAM)
-				// mode 3: OAM draw (no OAM/VRAM)
-				// mode 0: hblank (all accessible)
-				// mode 1: vblank (all accessible)
-				// modes go from 2 -> 3 -> 0 every visible scanline, then
-				// mode 1 for lines 144 onwards.
-				bool do_drawline = false;
-				auto old_scanline = mem.m_io.m_LY;
-				int old_mode = mem.m_io.stat_getMode();
-				bool did_vblStart = false;
-				bool do_flipscreen = false;
-
-				if(m_dotclock >= m_dotclockLimit) {
-					m_dotclock -= m_dotclockLimit;
-
-					if(m_dotclockMode == 0 || m_dotclockMode == 1) {
-						mem.m_io.m_LY += 1;
-						if(mem.m_io.m_LY > 153) {
-							mem.m_io.m_LY = 0;
-						}
-						did_vblStart = (mem.m_io.m_LY == fern::SCREEN_Y);
-					//	did_vblStart = (mem.m_io.m_LY == 0);
-						do_flipscreen = did_vblStart;
-
-						m_lycCooldown = true;
-						if(m_dotclockMode == 0 || mem.m_io.m_LY < fern::SCREEN_Y) {
-							// continue in mode 2 if vblank period not reached
-							m_dotclockMode = 2;
-							m_dotclockLimit = 80;
-							do_drawline = true;
-						} else {
-							m_dotclockMode = 1;
-							m_dotclockLimit = 456;
-						}
-					} else if(m_dotclockMode == 2) {
-						m_dotclockMode = 3;
-						m_dotclockLimit = 172;
+		auto &mem = emu()->mem;
+		// 4 dots per cycle
+		if(mem.m_io.ppu_enabled()) {
+			int mul = speed_doubled() ? 2 : 4;
+			m_dotclock += (elapsed*mul);
+		}
+	}
+
+	// works out when each event's due next, from the caught up counters.
+	auto CCPU::clock_schedule() -> void {
+		auto &mem = emu()->mem;
+
+		if(mem.m_io.ppu_enabled()) {
+			int mul = speed_doubled() ? 2 : 4;
+			const int dots_left = m_dotclockLimit - m_dotclock;
+			m_clockEvents[ClockEvent::ppu] = m_clockCycles + (dots_left + mul - 1) / mul;
+		} else {
+			m_clockEvents[ClockEvent::ppu] = CLOCKEVENT_NEVER;
+		}
+
+		// timer_catchup() has just run, so this is from now
+		if(mem.m_io.timer_enabled()) {
+			const uint64_t to_overflow = 0x100 - mem.m_io.m_TIMA;
+			const uint64_t cycles = to_overflow*mem.m_io.timer_limit() - m_timerctrMain;
+			m_clockEvents[ClockEvent::tima] = m_clockCycles + cycles;
+		} else {
+			m_clockEvents[ClockEvent::tima] = CLOCKEVENT_NEVER;
+		}
+		m_clockEvents[ClockEvent::run] = m_runLimit;
+
+		m_clockNextEvent = CLOCKEVENT_NEVER;
+		for(auto deadline : m_clockEvents) {
+			m_clockNextEvent = std::min(m_clockNextEvent,deadline);
+		}
+		// pending interrupts are checked on every tick until they're taken,
+		// if they can be: IME's on (or about to be), or they'd end a halt.
+		// ei and reti reschedule, so this is looked at again when they run.
+		const bool can_take = m_regIME || m_should_enableIME || m_haltwaiting;
+		if((mem.m_io.m_IF & mem.m_io.m_IE) != 0 && can_take) {
+			m_clockNextEvent = m_clockCycles;
+		}
+	}
+
+	// called by clock_tick() once an event is due.
+	auto CCPU::clock_update() -> void {
+		m_clockUpdates += 1;
+		// an interrupt taken here adds 5 more cycles, which go round again
+		bool ticking = true;
+		while(ticking) {
+			ticking = false;
+			clock_catchup();
+
+			auto &mem = emu()->mem;
+			// set current mode
+			// mode 2: OAM scan (0-79?) (no OAM)
+			// mode 3: OAM draw (no OAM/VRAM)
+			// mode 0: hblank (all accessible)
+			// mode 1: vblank (all accessible)
+			// modes go from 2 -> 3 -> 0 every visible scanline, then
+			// mode 1 for lines 144 onwards.
+			bool do_drawline = false;
+			auto old_scanline = mem.m_io.m_LY;
+			int old_mode = mem.m_io.stat_getMode();
+			bool did_vblStart = false;
+			bool do_flipscreen = false;
+
+			if(m_dotclock >= m_dotclockLimit) {
+				m_dotclock -= m_dotclockLimit;
+
+				if(m_dotclockMode == 0 || m_dotclockMode == 1) {
+					mem.m_io.m_LY += 1;
+					if(mem.m_io.m_LY > 153) {
+						mem.m_io.m_LY = 0;
+					}
+					did_vblStart = (mem.m_io.m_LY == fern::SCREEN_Y);
+				//	did_vblStart = (mem.m_io.m_LY == 0);
+					do_flipscreen = did_vblStart;
+
+					m_lycCooldown = true;
+					if(m_dotclockMode == 0 || mem.m_io.m_LY < fern::SCREEN_Y) {
+						// continue in mode 2 if vblank period not reached
+						m_dotclockMode = 2;
+						m_dotclockLimit = 80;
+						do_drawline = true;
 					} else {
-						m_dotclockMode = 0;
-						m_dotclockLimit = 204;
+						m_dotclockMode = 1;
+						m_dotclockLimit = 456;
 					}
-				}
-				mem.m_io.stat_setMode(m_dotclockMode);
-
-				if(!mem.m_io.ppu_enabled()) {
-					mem.m_io.m_LY = 0;
-					m_dotclock = 0;
+				} else if(m_dotclockMode == 2) {
+					m_dotclockMode = 3;
+					m_dotclockLimit = 172;
+				} else {
 					m_dotclockMode = 0;
 					m_dotclockLimit = 204;
-					mem.m_io.stat_setMode(m_dotclockMode);
 				}
+			}
+			mem.m_io.stat_setMode(m_dotclockMode);
 
-				mem.stat_lycSync();
+			if(!mem.m_io.ppu_enabled()) {
+				mem.m_io.m_LY = 0;
+				m_dotclock = 0;
+				m_dotclockMode = 0;
+				m_dotclockLimit = 204;
+				mem.m_io.stat_setMode(m_dotclockMode);
+			}
+			if(mem.vram_accessible() != mem.m_pageVRAMWritable) {
+				mem.pages_mapVRAM();
+			}
 
-				// set flags based on mode changes ------@/
-				if(mem.m_io.ppu_enabled()) {
-					const int cur_mode = mem.m_io.stat_getMode();
-					if(cur_mode != old_mode) {
-						bool do_setflag = false;
-						if((cur_mode == 0) && (mem.m_io.m_STAT & RFlagSTAT::mode0int)) {
-							do_setflag = true;
-						}
-						if((cur_mode == 1) && (mem.m_io.m_STAT & RFlagSTAT::mode1int)) {
-							do_setflag = true;
-						}
-						if((cur_mode == 2) && (mem.m_io.m_STAT & RFlagSTAT::mode2int)) {
-							do_setflag = true;
-						}
-						mem.m_io.m_IF |= do_setflag ? RFlagIF::stat : 0;
-					}
-				}
+			mem.stat_lycSync();
 
-				if((mem.m_io.m_STAT & RFlagSTAT::lycint) && mem.m_io.stat_lycSame() && m_lycCooldown) {
-					if(mem.m_io.ppu_enabled()) {
-						mem.m_io.m_IF |= RFlagIF::stat;
-						m_lycCooldown = false;
+			// set flags based on mode changes ------@/
+			if(mem.m_io.ppu_enabled()) {
+				const int cur_mode = mem.m_io.stat_getMode();
+				if(cur_mode != old_mode) {
+					bool do_setflag = false;
+					if((cur_mode == 0) && (mem.m_io.m_STAT & RFlagSTAT::mode0int)) {
+						do_setflag = true;
+					}
+					if((cur_mode == 1) && (mem.m_io.m_STAT & RFlagSTAT::mode1int)) {
+						do_setflag = true;
 					}
+					if((cur_mode == 2) && (mem.m_io.m_STAT & RFlagSTAT::mode2int)) {
+						do_setflag = true;
+					}
+					mem.m_io.m_IF |= do_setflag ? RFlagIF::stat : 0;
 				}
+			}
 
-				if(did_vblStart) {
-					mem.m_io.m_IF |= RFlagIF::vblank;
-					do_flipscreen = true;
+			if((mem.m_io.m_STAT & RFlagSTAT::lycint) && mem.m_io.stat_lycSame() && m_lycCooldown) {
+				if(mem.m_io.ppu_enabled()) {
+					mem.m_io.m_IF |= RFlagIF::stat;
+					m_lycCooldown = false;
 				}
+			}
+
+			if(did_vblStart) {
+				mem.m_io.m_IF |= RFlagIF::vblank;
+				do_flipscreen = true;
+			}
 
-				// tick timers --------------------------@/
-				m_timerctrDiv += wait_cycles;
-				while(m_timerctrDiv >= 64) {
-					m_timerctrDiv -= 64;
-					mem.m_io.m_DIV += 1;
+			// catch up timers (overflows) ----------@/
+			timer_catchup();
+
+			// deal with interrupts, if enabled. ----@/
+			if((mem.m_io.m_IF & mem.m_io.m_IE) != 0) {
+				m_haltwaiting = false;	
+			}
+			if(m_regIME) {
+				// vblank interrupt
+				if(mem.interrupt_match(BIT(0))) {
+					mem.interrupt_clear(BIT(0));
+					m_regIME = false;
+					stack_push16(m_PC);
+					m_PC = 0x40;
+					profile_interrupt(0x40);
+					m_clockCycles += 5;
+					ticking = true;
 				}
-				if(mem.m_io.m_TAC & BIT(2)) {
-					m_timerctrMain += wait_cycles;
+				// LCD interrupt
+				else if(mem.interrupt_match(BIT(1))) {
+					mem.interrupt_clear(BIT(1));
+					m_regIME = false;
+					stack_push16(m_PC);
+					m_PC = 0x48;
+					profile_interrupt(0x48);
+					m_clockCycles += 5;
+					ticking = true;
 				}
-				const std::array<int,4> timer_limts = { 256,4,16,64 };
-				int maintimer_limit = timer_limts[mem.m_io.m_TAC & 0b11];
-				if(m_timerctrMain >= maintimer_limit) {
-					m_timerctrMain -= maintimer_limit;
-					mem.m_io.m_TIMA += 1;
-					if(mem.m_io.m_TIMA == 0) {
-						mem.m_io.m_IF |= RFlagIF::timer;
-						mem.m_io.m_TIMA = mem.m_io.m_TMA;
-					}
+				// timer interrupt
+				else if(mem.interrupt_match(BIT(2))) {
+					mem.interrupt_clear(BIT(2));
+					m_regIME = false;
+					stack_push16(m_PC);
+					m_PC = 0x50;
+					profile_interrupt(0x50);
+					m_clockCycles += 5;
+					ticking = true;
 				}
-
-				// deal with interrupts, if enabled. ----@/
-				if((mem.m_io.m_IF & mem.m_io.m_IE) != 0) {
-					m_haltwaiting = false;	
+				// serial interrupt
+				else if(mem.interrupt_match(0x08)) {
+					std::puts("unimplemented interrupt (serial)");
+					std::exit(-1);
 				}
-				if(m_regIME) {
-					// vblank interrupt
-					if(mem.interrupt_match(BIT(0))) {
-						mem.interrupt_clear(BIT(0));
-						m_regIME = false;
-						stack_push16(m_PC);
-						m_PC = 0x40;
-						clock_tick(5);
-					}
-					// LCD interrupt
-					else if(mem.interrupt_match(BIT(1))) {
-						mem.interrupt_clear(BIT(1));
-						m_regIME = false;
-						stack_push16(m_PC);
-						m_PC = 0x48;
-						clock_tick(5);
-					}
-					// timer interrupt
-					else if(mem.interrupt_match(BIT(2))) {
-						mem.interrupt_clear(BIT(2));
-						m_regIME = false;
-						stack_push16(m_PC);
-						m_PC = 0x50;
-						clock_tick(5);
-					}
-					// serial interrupt
-					else if(mem.interrupt_match(0x08)) {
-						std::puts("unimplemented interrupt (serial)");
-						std::exit(-1);
-					}
-					// joypad interrupt
-					else if(mem.interrupt_match(0x10)) {
-						std::puts("unimplemented interrupt (joypad)");
-						std::exit(-1);
-					}
+				// joypad interrupt
+				else if(mem.interrupt_match(0x10)) {
+					std::puts("unimplemented interrupt (joypad)");
+					std::exit(-1);
 				}
+			}
 
-				if(do_drawline) {
-					if(!mem.m_io.ppu_enabled()) {
-						std::puts("CCPU::clock_tick(): bad drawline?");
-						std::exit(-1);
-					}
-					emu()->renderer.draw_line(old_scanline);
-				}
-				if(do_flipscreen) {
-					emu()->renderer.present();
+			if(do_drawline) {
+				if(!mem.m_io.ppu_enabled()) {
+					std::puts("CCPU::clock_update(): bad drawline?");
+					std::exit(-1);
 				}
+				emu()->renderer.draw_line(old_scanline);
+			}
+			// presenting's left to whoever's running the CPU
+			if(do_flipscreen) {
+				m_frameDone = true;
+				if(m_runToFrame) m_runStop = true;
 			}
-
-			m_clockWaiting = false;
-		}
-		// otherwise, wait til current fn's done	
-		else {
-			m_clockWaitBuffer.push(cyclecnt);
 		}
+		if(m_clockCycles >= m_runLimit) m_runStop = true;
+		clock_schedule();
 	}
 }
 
@@ -0,0 +1,238 @@
+#include <fern.h>
+#include <fern_common.h>
+
+// cached interpreter core --------------------------------------------------@/
+// built in place of the table core's CCPU::run() when FERN_CPUCORE_CACHED is
+// defined. code in ROM, WRAM and HRAM is decoded into blocks (one run of
+// instructions up to the next branch), which are kept by bank and address.
+// running a block skips fetching and decoding: handlers are called straight
+// from the block, and read_pc() gets the operands from the block's copy of
+// the instruction bytes.
+// anything else (VRAM, SRAM, echo RAM, OAM) just goes through step().
+#ifdef FERN_CPUCORE_CACHED
+
+namespace {
+	// instruction lengths, including the opcode byte.
+	constexpr auto blockcache_lengths = []() {
+		std::array<uint8_t,0x100> lengths {};
+		// (not fill(), which isn't constexpr before C++20)
+		for(auto& length : lengths) length = 1;
+		const int len2[] = {
+			0x06,0x0E,0x16,0x1E,0x26,0x2E,0x36,0x3E, // ld r,imm8
+			0x10, // stop
+			0x18,0x20,0x28,0x30,0x38, // jr
+			0xC6,0xCE,0xD6,0xDE,0xE6,0xEE,0xF6,0xFE, // alu imm8
+			0xCB,0xE0,0xF0,0xE8,0xF8
+		};
+		const int len3[] = {
+			0x01,0x11,0x21,0x31,0x08, // ld rr,imm16 / ld [a16],sp
+			0xC2,0xC3,0xCA,0xD2,0xDA, // jp
+			0xC4,0xCC,0xCD,0xD4,0xDC, // call
+			0xEA,0xFA
+		};
+		for(auto op : len2) lengths[op] = 2;
+		for(auto op : len3) lengths[op] = 3;
+		return lengths;
+	}();
+	// opcodes that can change PC (or stop the CPU) end a block.
+	constexpr auto blockcache_enders = []() {
+		std::array<bool,0x100> enders {};
+		const int ops[] = {
+			0x18,0x20,0x28,0x30,0x38, // jr
+			0xC2,0xC3,0xCA,0xD2,0xDA,0xE9, // jp
+			0xC4,0xCC,0xCD,0xD4,0xDC, // call
+			0xC0,0xC8,0xC9,0xD0,0xD8,0xD9, // ret
+			0xC7,0xCF,0xD7,0xDF,0xE7,0xEF,0xF7,0xFF, // rst
+			0x10,0x76, // stop, halt
+			0xD3,0xDB,0xDD,0xE3,0xE4,0xEB,0xEC,0xED,0xF4,0xFC,0xFD // invalid
+		};
+		for(auto op : ops) enders[op] = true;
+		return enders;
+	}();
+
+	// where the region containing addr ends, for cacheable regions.
+	auto blockcache_regionEnd(int addr) -> int {
+		if(addr < 0x4000) return 0x4000;
+		if(addr < 0x8000) return 0x8000;
+		if(addr < 0xD000) return 0xD000;
+		if(addr < 0xE000) return 0xE000;
+		return 0xFFFF;
+	}
+}
+
+namespace fern {
+	auto CCPU::blockcache_clear() -> void {
+		m_blockcacheRom.clear();
+		m_blockcacheRam.clear();
+		m_blockcacheRamCode.fill(0);
+		m_blockcacheRamDirty = false;
+		m_pcbytes = nullptr;
+#ifdef FERN_JIT
+		m_jitUsed = 0;
+#endif
+	}
+	// the bank code at addr is running from (see code_bank()), or -1 if it
+	// can't be cached. only ROM, WRAM and HRAM are, since RAM writes are
+	// only checked for code (m_blockcacheRamCode) from $C000 up.
+	auto CCPU::blockcache_bank(int addr) -> int {
+		const bool cacheable = (addr < 0x8000)
+			|| (addr >= 0xC000 && addr < 0xE000)
+			|| (addr >= 0xFF80 && addr < 0xFFFF);
+		return cacheable ? code_bank(addr) : -1;
+	}
+	auto CCPU::blockcache_build(int bank) -> CCPUBlock {
+		auto& mem = m_emu->mem;
+		CCPUBlock block;
+		block.bank = bank;
+		block.breakpoint = false;
+#ifdef FERN_JIT
+		block.hits = 0;
+		block.jitfn = nullptr;
+#endif
+
+		const int region_end = blockcache_regionEnd(m_PC);
+		const bool in_ram = m_PC >= 0x8000;
+		int pc = m_PC;
+		// peek(), so read watchpoints don't fire on bytes that are only
+		// being decoded (and might never run)
+		while(block.instrs.size() < BLOCKCACHE_MAXLEN) {
+			const int opcode = mem.peek(pc);
+			const int length = blockcache_lengths[opcode];
+			if(pc + length > region_end) break;
+
+			CCPUDecodedInstr instr;
+			instr.fn = m_opcodetable[opcode].fn;
+			instr.pc = pc;
+			instr.opcode = opcode;
+			instr.length = length;
+			instr.bytes = {};
+			for(int i=0; i<length; i++) {
+				instr.bytes[i] = mem.peek(pc + i);
+			}
+			block.instrs.push_back(instr);
+			block.breakpoint |= m_breakPages[pc>>8];
+
+			// mark the bytes, so writing to them drops the block
+			if(in_ram) {
+				for(int i=0; i<length; i++) {
+					const int index = (pc + i) - 0xC000;
+					m_blockcacheRamCode[index>>3] |= 1<<(index&7);
+				}
+			}
+
+			pc += length;
+			if(blockcache_enders[opcode]) break;
+		}
+		return block;
+	}
+	auto CCPU::blockcache_find() -> CCPUBlock* {
+		const int bank = blockcache_bank(m_PC);
+		if(bank < 0) return nullptr;
+
+		auto& cache = (m_PC < 0x8000) ? m_blockcacheRom : m_blockcacheRam;
+		const uint32_t key = (bank<<16) | m_PC;
+		auto found = cache.find(key);
+		if(found != cache.end()) {
+			return &found->second;
+		}
+
+		auto block = blockcache_build(bank);
+		if(block.instrs.empty()) return nullptr;
+		return &cache.emplace(key,std::move(block)).first->second;
+	}
+
+	// called whenever breakpoints change.
+	auto CCPU::blockcache_breakpointsUpdate() -> void {
+		for(auto cache : { &m_blockcacheRom,&m_blockcacheRam }) {
+			for(auto& [key,block] : *cache) {
+				block.breakpoint = false;
+				for(const auto& instr : block.instrs) {
+					block.breakpoint |= m_breakPages[instr.pc>>8];
+				}
+			}
+		}
+	}
+
+	// what step() does before running an instruction.
+	auto CCPU::blockcache_instrBegin(const CCPUDecodedInstr& instr) -> void {
+		if(m_should_enableIME) {
+			m_should_enableIME = false;
+			m_regIME = true;
+		}
+		instrhistory_push(m_emu->mem.m_rombankLatched,m_PC);
+		profile_begin(instr.opcode,m_PC);
+		trace_begin(m_PC);
+
+		m_curopcode = instr.opcode;
+		m_curopcode_ptr = &m_opcodetable[instr.opcode];
+		m_pcbytes = instr.bytes.data();
+	}
+
+	auto CCPU::run(int instr_count) -> void {
+		int instrs_left = instr_count;
+
+		while(instrs_left > 0 && !m_runStop) {
+			// RAM blocks are only dropped between blocks, never while one runs
+			if(m_blockcacheRamDirty) {
+				m_blockcacheRam.clear();
+				m_blockcacheRamCode.fill(0);
+				m_blockcacheRamDirty = false;
+			}
+
+			auto block = blockcache_find();
+			if(!block) {
+				if(break_check(m_PC)) break;
+				step();
+				instrs_left -= 1;
+				continue;
+			}
+			size_t first = 0;
+#ifdef FERN_JIT
+			// hot ROM blocks get compiled, if m_jitEnabled. ones with
+			// breakpoints are left to the loop below, which checks them, as
+			// are blocks that need to stop partway or be profiled/traced
+			// per instruction.
+			if(m_jitEnabled && !block->jitfn && !block->breakpoint && m_PC < 0x8000) {
+				block->hits += 1;
+				if(block->hits >= JIT_HOTCOUNT) {
+					block->jitfn = jit_compile(*block);
+				}
+			}
+			if(m_jitEnabled && block->jitfn && !block->breakpoint && instrs_left >= static_cast<int>(block->instrs.size())
+				&& !profile_enabled() && !trace_enabled()) {
+				// what blockcache_instrBegin() would do first
+				if(m_should_enableIME) {
+					m_should_enableIME = false;
+					m_regIME = true;
+				}
+				flag_materialize();
+				first = block->jitfn();
+				instrs_left -= first;
+			}
+#endif
+
+			int last_pc = (first > 0) ? block->instrs[first - 1].pc : -1;
+			for(size_t i=first; i<block->instrs.size(); i++) {
+				const auto& instr = block->instrs[i];
+				if(instrs_left <= 0 || m_runStop) break;
+				// interrupts, bank switches & writes to the block's own code
+				// all end it early.
+				if(m_PC != instr.pc || m_blockcacheRamDirty) break;
+				if(blockcache_bank(m_PC) != block->bank) break;
+				if(block->breakpoint && break_check(m_PC)) break;
+				instrs_left -= 1;
+
+				blockcache_instrBegin(instr);
+				instr.fn(this,m_emu);
+				m_pcbytes = nullptr;
+				last_pc = instr.pc;
+			}
+			// blocks end at branches, so only the last one can loop back
+			if(m_PC <= last_pc) {
+				instrs_left -= idle_skip(last_pc,instrs_left);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,187 @@
+#include <fern.h>
+#include <fern_common.h>
+#include <algorithm>
+
+// idle loop skipping -------------------------------------------------------@/
+// games often wait with a short loop that only reads (LY, STAT, a flag in
+// WRAM set by an interrupt...), like `ldh a,[$44] / cp N / jr nz`.
+// loops that only change A and F, and don't write or jump anywhere but back,
+// do exactly the same thing every time round as long as what they read
+// stays the same, and that can only change with a clock event (DIV and
+// TIMA don't have events, so loops reading them aren't skipped). so once
+// one comes back round to the same state, whole iterations are skipped by
+// moving the clock forward, up to just before the next event.
+// skipped iterations don't show up in the instruction history.
+#ifndef FERN_NO_IDLESKIP
+
+namespace {
+	// lengths of opcodes that can be in an idle loop, 0 for anything that
+	// writes memory, jumps, changes the CPU's state (ei/di/halt/stop) or
+	// changes a register other than A (which reads might depend on).
+	constexpr auto idleloop_lengths = []() {
+		std::array<uint8_t,0x100> lengths {};
+		lengths[0x00] = 1; // nop
+		for(int op=0x78; op<0xC0; op++) lengths[op] = 1; // ld a,r / alu a,r
+		const int len1[] = {
+			0x3C,0x3D, // inc/dec a
+			0x07,0x0F,0x17,0x1F,0x27,0x2F,0x37,0x3F, // rotates/daa/cpl/scf/ccf
+			0x0A,0x1A,0xF2 // ld a,[bc] / ld a,[de] / ld a,[c]
+		};
+		const int len2[] = {
+			0x3E, // ld a,imm8
+			0xC6,0xCE,0xD6,0xDE,0xE6,0xEE,0xF6,0xFE, // alu imm8
+			0xF0, // ldh a,[n]
+			0xCB // checked separately
+		};
+		for(auto op : len1) lengths[op] = 1;
+		for(auto op : len2) lengths[op] = 2;
+		lengths[0xFA] = 3; // ld a,[a16]
+		return lengths;
+	}();
+	constexpr auto idleloop_isJr(int opcode) -> bool {
+		return opcode == 0x18 || opcode == 0x20 || opcode == 0x28
+			|| opcode == 0x30 || opcode == 0x38;
+	}
+	// where a loop's reads come from. registers besides A don't change in
+	// the loop, so these are worked out with whatever they are at the time.
+	enum {
+		IDLEREAD_HL = -1,
+		IDLEREAD_BC = -2,
+		IDLEREAD_DE = -3,
+		IDLEREAD_C = -4
+	};
+}
+
+namespace fern {
+	auto CCPU::idle_reset() -> void {
+		m_idleLoopPC = -1;
+		m_idleLoopBranch = -1;
+		m_idleLoopBank = 0;
+		m_idleLoopInstrs = 0;
+		m_idleLoopReadCount = 0;
+		m_idleLoopRegs = {};
+		m_idleLoopValues = {};
+		m_idleLoopCycles = 0;
+		m_idleLoopIterCycles = 0;
+		m_idleLoopUpdates = 0;
+		m_idleSkips = 0;
+		m_idleSkippedCycles = 0;
+	}
+
+	// checks the loop from target to the jr at branch_pc, and notes what it reads.
+	auto CCPU::idle_decode(int target,int branch_pc) -> void {
+		auto& mem = m_emu->mem;
+		m_idleLoopInstrs = 0;
+		m_idleLoopReadCount = 0;
+		m_idleLoopIterCycles = 0;
+
+		auto add_read = [&](int source) -> bool {
+			if(m_idleLoopReadCount >= IDLELOOP_MAXREADS) return false;
+			m_idleLoopReads[m_idleLoopReadCount++] = source;
+			return true;
+		};
+
+		int pc = target;
+		int instrs = 0;
+		while(pc < branch_pc && (pc - target) < IDLELOOP_MAXLEN) {
+			const int op = mem.read(pc);
+			const int length = idleloop_lengths[op];
+			bool ok = length != 0;
+
+			if(op == 0xCB) {
+				// only bit, or anything on A
+				const int cb_op = mem.read(pc + 1);
+				const int reg = cb_op & 7;
+				const bool is_bit = cb_op >= 0x40 && cb_op < 0x80;
+				ok = is_bit || reg == RegisterName::A;
+				if(ok && reg == RegisterName::HLData) ok = add_read(IDLEREAD_HL);
+			}
+			else if(op >= 0x78 && op < 0xC0 && (op & 7) == RegisterName::HLData) {
+				ok = add_read(IDLEREAD_HL);
+			}
+			else if(op == 0x0A) ok = add_read(IDLEREAD_BC);
+			else if(op == 0x1A) ok = add_read(IDLEREAD_DE);
+			else if(op == 0xF2) ok = add_read(IDLEREAD_C);
+			else if(op == 0xF0) ok = add_read(0xFF00 | mem.read(pc + 1));
+			else if(op == 0xFA) ok = add_read(mem.read(pc + 1) | (mem.read(pc + 2)<<8));
+
+			if(!ok) return;
+			pc += length;
+			instrs += 1;
+		}
+		if(pc == branch_pc) {
+			m_idleLoopInstrs = instrs + 1;
+		}
+	}
+
+	auto CCPU::idle_skip(int branch_pc,int instrs_left) -> int {
+		// traces should have every instruction in them, and breakpoints
+		// and watchpoints should see every hit
+		if(m_runStop || trace_enabled() || m_emu->mem.watch_active()) return 0;
+		if(m_breakPages[branch_pc>>8] || m_breakPages[m_PC>>8]) return 0;
+		auto& mem = m_emu->mem;
+		const int opcode = mem.read(branch_pc);
+		if(!idleloop_isJr(opcode)) return 0;
+		// an interrupt could've been taken right after the jr
+		const int target = (branch_pc + 2 + static_cast<int8_t>(mem.read(branch_pc + 1))) & 0xFFFF;
+		if(m_PC != target) return 0;
+
+		// new loop: check what's in it once
+		const int bank = mem.m_rombankLatched;
+		const bool new_loop = target != m_idleLoopPC || branch_pc != m_idleLoopBranch
+			|| bank != m_idleLoopBank;
+		if(new_loop) {
+			m_idleLoopPC = target;
+			m_idleLoopBranch = branch_pc;
+			m_idleLoopBank = bank;
+			idle_decode(target,branch_pc);
+		}
+		if(m_idleLoopInstrs == 0) return 0;
+
+		const std::array<int,5> regs = { reg_af(),reg_bc(),reg_de(),reg_hl(),m_SP };
+		std::array<int,IDLELOOP_MAXREADS> values {};
+		for(int i=0; i<m_idleLoopReadCount; i++) {
+			int addr = m_idleLoopReads[i];
+			switch(addr) {
+				case IDLEREAD_HL: addr = reg_hl(); break;
+				case IDLEREAD_BC: addr = reg_bc(); break;
+				case IDLEREAD_DE: addr = reg_de(); break;
+				case IDLEREAD_C: addr = 0xFF00 | m_regC; break;
+			}
+			if(addr == 0xFF04 || addr == 0xFF05) return 0;
+			values[i] = mem.read(addr);
+		}
+
+		// back round to the same state. one event since then is fine if
+		// it didn't change anything the loop reads, as long as the
+		// iteration took as long as one without it (so no interrupt ran).
+		const uint64_t cycles = m_clockCycles - m_idleLoopCycles;
+		const uint64_t updates = m_clockUpdates - m_idleLoopUpdates;
+		const bool same = !new_loop && regs == m_idleLoopRegs && values == m_idleLoopValues;
+		if(same && updates == 0) {
+			m_idleLoopIterCycles = cycles;
+		}
+		if(same && updates <= 1 && cycles == m_idleLoopIterCycles && cycles > 0
+			&& !m_should_enableIME && m_clockNextEvent > m_clockCycles) {
+			uint64_t iterations = (m_clockNextEvent - m_clockCycles - 1) / cycles;
+			iterations = std::min<uint64_t>(iterations,instrs_left / m_idleLoopInstrs);
+			if(iterations > 0) {
+				m_clockCycles += iterations * cycles;
+				m_idleSkips += 1;
+				m_idleSkippedCycles += iterations * cycles;
+
+				m_idleLoopCycles = m_clockCycles;
+				m_idleLoopUpdates = m_clockUpdates;
+				return iterations * m_idleLoopInstrs;
+			}
+		}
+
+		m_idleLoopRegs = regs;
+		m_idleLoopValues = values;
+		m_idleLoopCycles = m_clockCycles;
+		m_idleLoopUpdates = m_clockUpdates;
+		return 0;
+	}
+}
+
+#endif
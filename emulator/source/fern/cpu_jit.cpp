@@ -0,0 +1,1310 @@
+#include <fern.h>
+#include <fern_common.h>
+#include <functional>
+
+// x86-64 JIT ---------------------------------------------------------------@/
+// compiles hot ROM blocks from the cached core (see cpu_cached.cpp) into
+// native code, when FERN_JIT is defined. run() has already checked PC and
+// the ROM bank by finding the block, so the code has no per-instruction
+// guards:
+// - the SM83 registers live in host registers for the whole block.
+// - loads, stores, ALU ops, the CB ops, the stack and branches are all done
+//   natively. memory goes straight through CMem's page tables (ROM, WRAM,
+//   SRAM...), and to m_hram for HRAM. anything else (IO, OAM, mapper
+//   registers, watched pages) calls the instruction's handler, as do the
+//   few instructions that aren't worth it (daa, ld [a16],sp, add sp,e,
+//   ld hl,sp+e, halt, stop).
+// - cycles are counted at compile time. the clock is only brought up to
+//   date when the block calls out or exits, or after an instruction that
+//   reaches the next event, which is the only time an interrupt can be
+//   taken (see clock_update()).
+// - the instruction history is also only written then, just the entries
+//   that'll still be in it.
+// a handler that jumps or changes the bank, an interrupt, or run_until()
+// stopping all end the block early; run() does the rest in the interpreter.
+#ifdef FERN_JIT
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+#endif
+
+namespace {
+	// host registers
+	enum {
+		RAX,RCX,RDX,RBX,RSP,RBP,RSI,RDI,
+		R8,R9,R10,R11,R12,R13,R14,R15
+	};
+#ifdef _WIN32
+	constexpr int REG_ARG0 = RCX;
+	constexpr int REG_ARG1 = RDX;
+#else
+	constexpr int REG_ARG0 = RDI;
+	constexpr int REG_ARG1 = RSI;
+#endif
+	// where things are kept while a block runs. SM83 registers are by
+	// RegisterName, and always zero-extended.
+	constexpr std::array<int,8> HOST_REGS = { R8,R9,R10,R11,R12,R13,-1,R14 };
+	constexpr int HOST_A = R14;
+	constexpr int HOST_F = RSI;
+	constexpr int HOST_SP = RDI;
+	constexpr int HOST_CPU = R15;
+	constexpr int HOST_BUDGET = RBP; // cycles from the block's clock to the next event
+	constexpr int HOST_FLAGTABLES = RBX;
+	// rax, rcx and rdx are scratch. [rsp+32] holds the ROM bank over calls.
+	constexpr int STACK_BANK = 32;
+
+	// condition codes
+	enum {
+		CC_C = 0x2,CC_NC = 0x3,CC_Z = 0x4,CC_NZ = 0x5,
+		CC_BE = 0x6,CC_A = 0x7
+	};
+	// ALU ops and shifts, by their opcode extension
+	enum { ALU_ADD,ALU_OR,ALU_ADC,ALU_SBB,ALU_AND,ALU_SUB,ALU_XOR,ALU_CMP };
+	enum { SH_ROL,SH_ROR,SH_RCL,SH_RCR,SH_SHL,SH_SHR,SH_SAR = 7 };
+
+	// F bits from the host flags, indexed by lahf's AH: Z/H/C (adds and
+	// subtracts), Z/H (inc/dec, which keep C) and just Z (logic ops).
+	// x86's AF is the same as the SM83's H for all of these.
+	constexpr auto jit_flagTables = []() {
+		std::array<uint8_t,0x300> tables {};
+		for(int ah=0; ah<0x100; ah++) {
+			const int z = (ah>>6) & 1;
+			const int h = (ah>>4) & 1;
+			const int c = ah & 1;
+			tables[ah] = (z<<7) | (h<<5) | (c<<4);
+			tables[0x100 + ah] = (z<<7) | (h<<5);
+			tables[0x200 + ah] = z<<7;
+		}
+		return tables;
+	}();
+	enum { FLAGS_ZHC,FLAGS_ZH,FLAGS_Z };
+
+	// [base + index*scale + disp]
+	struct CJitMem {
+		int base;
+		int index;
+		int scale;
+		int32_t disp;
+	};
+	constexpr auto mem_at(int base,int32_t disp) -> CJitMem { return { base,-1,1,disp }; }
+	constexpr auto mem_at(int base,int index,int scale,int32_t disp) -> CJitMem {
+		return { base,index,scale,disp };
+	}
+	constexpr auto mem_next(const CJitMem& m) -> CJitMem { return { m.base,m.index,m.scale,m.disp + 1 }; }
+
+	class CJitEmitter {
+		private:
+			uint8_t* m_code;
+			size_t m_size;
+			size_t m_pos;
+			std::vector<size_t> m_labels;
+			std::vector<std::pair<size_t,int>> m_fixups; // rel32s, and the labels they go to
+			std::vector<std::function<void()>> m_cold; // emitted after everything else
+		public:
+			CJitEmitter(uint8_t* code,size_t size)
+				: m_code(code),m_size(size),m_pos(0)
+				{}
+
+			auto pos() const -> size_t { return m_pos; }
+			auto overflowed() const -> bool { return m_pos > m_size; }
+
+			auto u8(int n) -> void {
+				if(m_pos < m_size) m_code[m_pos] = n;
+				m_pos += 1;
+			}
+			auto u16(int n) -> void { u8(n); u8(n>>8); }
+			auto u32(uint32_t n) -> void { u16(n); u16(n>>16); }
+			auto u64(uint64_t n) -> void { u32(n); u32(n>>32); }
+
+			auto label() -> int {
+				m_labels.push_back(SIZE_MAX);
+				return m_labels.size() - 1;
+			}
+			auto bind(int label) -> void { m_labels[label] = m_pos; }
+			// code that's rarely run, kept out of the way
+			auto cold(std::function<void()> fn) -> void { m_cold.push_back(std::move(fn)); }
+			auto finish() -> void {
+				// cold code can add more cold code
+				for(size_t i=0; i<m_cold.size(); i++) {
+					auto fn = m_cold[i];
+					fn();
+				}
+				for(auto [fixup,label] : m_fixups) {
+					if(fixup + 4 > m_size) continue;
+					const int32_t rel = m_labels[label] - (fixup + 4);
+					for(int i=0; i<4; i++) m_code[fixup + i] = (rel >> (i*8)) & 0xFF;
+				}
+			}
+
+			// encoding -------------------------------------@/
+			// spl-dil need a REX prefix as 8-bit registers, or they'd be ah-bh
+			static constexpr auto byte_rex(int reg) -> bool { return reg >= RSP && reg <= RDI; }
+			auto rex(bool wide,int reg,int index,int base,bool force) -> void {
+				const int bits = (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index & 8) ? 2 : 0) | ((base & 8) ? 1 : 0);
+				if(bits || force) u8(0x40 | bits);
+			}
+			auto opcode(int op) -> void {
+				if(op > 0xFF) u8(op>>8);
+				u8(op);
+			}
+			// op reg,rm. size is 8, 16, 32 or 64, reg can be an opcode extension.
+			auto op_rr(int size,int op,int reg,int rm) -> void {
+				if(size == 16) u8(0x66);
+				rex(size == 64,reg,0,rm,size == 8 && (byte_rex(reg) || byte_rex(rm)));
+				opcode(op);
+				u8(0xC0 | ((reg & 7)<<3) | (rm & 7));
+			}
+			auto op_rm(int size,int op,int reg,const CJitMem& m) -> void {
+				if(size == 16) u8(0x66);
+				rex(size == 64,reg,std::max(m.index,0),m.base,size == 8 && byte_rex(reg));
+				opcode(op);
+				const bool sib = m.index >= 0 || (m.base & 7) == RSP;
+				const bool disp8 = m.disp >= -128 && m.disp < 128;
+				u8((disp8 ? 0x40 : 0x80) | ((reg & 7)<<3) | (sib ? 4 : (m.base & 7)));
+				if(sib) {
+					const int scale = (m.scale == 8) ? 3 : (m.scale == 4) ? 2 : (m.scale == 2) ? 1 : 0;
+					const int index = (m.index >= 0) ? m.index : RSP;
+					u8((scale<<6) | ((index & 7)<<3) | (m.base & 7));
+				}
+				if(disp8) u8(m.disp);
+				else u32(m.disp);
+			}
+			auto imm(int size,int32_t n) -> void {
+				if(size == 8) u8(n);
+				else if(size == 16) u16(n);
+				else u32(n);
+			}
+
+			// instructions ---------------------------------@/
+			auto mov(int size,int dst,int src) -> void { op_rr(size,(size == 8) ? 0x88 : 0x89,src,dst); }
+			auto load(int size,int dst,const CJitMem& m) -> void { op_rm(size,(size == 8) ? 0x8A : 0x8B,dst,m); }
+			auto store(int size,const CJitMem& m,int src) -> void { op_rm(size,(size == 8) ? 0x88 : 0x89,src,m); }
+			auto store_imm(int size,const CJitMem& m,int32_t n) -> void {
+				op_rm(size,(size == 8) ? 0xC6 : 0xC7,0,m);
+				imm(std::min(size,32),n);
+			}
+			auto mov_imm(int reg,uint32_t n) -> void {
+				rex(false,0,0,reg,false);
+				u8(0xB8 + (reg & 7));
+				u32(n);
+			}
+			auto mov_ptr(int reg,const void* ptr) -> void {
+				rex(true,0,0,reg,false);
+				u8(0xB8 + (reg & 7));
+				u64(reinterpret_cast<uintptr_t>(ptr));
+			}
+			// movzx dst32 from an 8 or 16-bit register or memory
+			auto movzx(int size,int dst,int src) -> void { op_rr((size == 8) ? 8 : 32,(size == 8) ? 0x0FB6 : 0x0FB7,dst,src); }
+			auto movzx_load(int size,int dst,const CJitMem& m) -> void { op_rm(32,(size == 8) ? 0x0FB6 : 0x0FB7,dst,m); }
+			auto movzx_ah() -> void { u8(0x0F); u8(0xB6); u8(0xC4); } // movzx eax,ah
+			auto lea(int size,int dst,const CJitMem& m) -> void { op_rm(size,0x8D,dst,m); }
+
+			auto alu(int size,int op,int dst,int src) -> void { op_rr(size,(op<<3) | ((size == 8) ? 0 : 1),src,dst); }
+			auto alu_load(int size,int op,int dst,const CJitMem& m) -> void { op_rm(size,(op<<3) | ((size == 8) ? 2 : 3),dst,m); }
+			auto alu_imm(int size,int op,int dst,int32_t n) -> void {
+				const bool short_imm = size != 8 && n >= -128 && n < 128;
+				op_rr(size,(size == 8) ? 0x80 : short_imm ? 0x83 : 0x81,op,dst);
+				imm(short_imm ? 8 : std::min(size,32),n);
+			}
+			auto alu_memImm(int size,int op,const CJitMem& m,int32_t n) -> void {
+				const bool short_imm = size != 8 && n >= -128 && n < 128;
+				op_rm(size,(size == 8) ? 0x80 : short_imm ? 0x83 : 0x81,op,m);
+				imm(short_imm ? 8 : std::min(size,32),n);
+			}
+			auto inc8(int reg) -> void { op_rr(8,0xFE,0,reg); }
+			auto dec8(int reg) -> void { op_rr(8,0xFE,1,reg); }
+			auto shift(int size,int op,int reg,int n) -> void {
+				if(n == 1) {
+					op_rr(size,(size == 8) ? 0xD0 : 0xD1,op,reg);
+				} else {
+					op_rr(size,(size == 8) ? 0xC0 : 0xC1,op,reg);
+					u8(n);
+				}
+			}
+			auto test(int size,int a,int b) -> void { op_rr(size,(size == 8) ? 0x84 : 0x85,b,a); }
+			auto test_imm(int size,int reg,int32_t n) -> void {
+				op_rr(size,(size == 8) ? 0xF6 : 0xF7,0,reg);
+				imm(size,n);
+			}
+			auto bt_imm(int reg,int bit) -> void { op_rr(32,0x0FBA,4,reg); u8(bit); }
+			auto bt(int reg,int bit_reg) -> void { op_rr(32,0x0FA3,bit_reg,reg); }
+			auto setcc(int cc,int reg) -> void { op_rr(8,0x0F90 | cc,0,reg); }
+			auto lahf() -> void { u8(0x9F); }
+
+			auto jcc(int cc,int label) -> void {
+				u8(0x0F); u8(0x80 | cc);
+				m_fixups.push_back({ m_pos,label });
+				u32(0);
+			}
+			auto jmp(int label) -> void {
+				u8(0xE9);
+				m_fixups.push_back({ m_pos,label });
+				u32(0);
+			}
+			auto call(int reg) -> void {
+				rex(false,0,0,reg,false);
+				u8(0xFF); u8(0xD0 | (reg & 7));
+			}
+			auto push(int reg) -> void { rex(false,0,0,reg,false); u8(0x50 + (reg & 7)); }
+			auto pop(int reg) -> void { rex(false,0,0,reg,false); u8(0x58 + (reg & 7)); }
+			auto ret() -> void { u8(0xC3); }
+	};
+
+	// where the CPU's state is, from the CPU (in r15), so it's all [r15+disp32]
+	struct CJitLayout {
+		std::array<int32_t,8> regs;
+		int32_t regF,regSP,regPC;
+		int32_t regIME,shouldEnableIME;
+		int32_t curopcode,curopcodePtr,pcbytes;
+		int32_t clockCycles,clockNextEvent,runStop;
+		int32_t history,historyPos;
+		int32_t pageRead,pageWrite,watchPages,hram,rombank;
+		int32_t ramCode,ramDirty;
+	};
+	// what compiled code calls
+	struct CJitCalls {
+		const void* clockUpdate;
+		const void* flagMaterialize;
+		std::array<const fern::CCPUInstrBase*,0x100> opcodes; // for m_curopcode_ptr
+	};
+
+	// how memory's addressed by an instruction
+	enum { ADDR_HL,ADDR_BC,ADDR_DE,ADDR_SP,ADDR_C,ADDR_ABS };
+	struct CJitAccess {
+		int kind;
+		int addr; // offset from SP for ADDR_SP, the address for ADDR_ABS
+		int span; // bytes
+		bool write;
+		bool modify; // reads and writes the same byte
+	};
+	typedef std::function<void(const CJitMem&)> CJitBody;
+
+	class CJitCompiler {
+		private:
+			CJitEmitter& m_emit;
+			const CJitLayout& m_at;
+			const CJitCalls& m_calls;
+			const fern::CCPUBlock& m_block;
+			fern::CEmulator* m_emu;
+			int m_exit; // epilogue, with the instruction count in eax
+			int m_after; // the current instruction's end, after the event check
+			int m_cycles; // cycles since the clock was brought up to date
+			int m_synced; // instructions already in the history
+
+			static auto cpu(int32_t offset) -> CJitMem { return mem_at(HOST_CPU,offset); }
+
+			// state -------------------------------------@/
+			auto spill() -> void {
+				for(int r=0; r<8; r++) {
+					if(HOST_REGS[r] >= 0) m_emit.store(8,cpu(m_at.regs[r]),HOST_REGS[r]);
+				}
+				m_emit.store(8,cpu(m_at.regF),HOST_F);
+				m_emit.store(16,cpu(m_at.regSP),HOST_SP);
+			}
+			auto reload() -> void {
+				for(int r=0; r<8; r++) {
+					if(HOST_REGS[r] >= 0) m_emit.movzx_load(8,HOST_REGS[r],cpu(m_at.regs[r]));
+				}
+				m_emit.movzx_load(8,HOST_F,cpu(m_at.regF));
+				m_emit.movzx_load(16,HOST_SP,cpu(m_at.regSP));
+			}
+			// cycles left until the next event, 0 if it's already been reached
+			auto budget() -> void {
+				const int ok = m_emit.label();
+				m_emit.load(64,HOST_BUDGET,cpu(m_at.clockNextEvent));
+				m_emit.alu_load(64,ALU_SUB,HOST_BUDGET,cpu(m_at.clockCycles));
+				m_emit.jcc(CC_NC,ok);
+				m_emit.alu(32,ALU_XOR,HOST_BUDGET,HOST_BUDGET);
+				m_emit.bind(ok);
+			}
+			// writes the history for instructions from-to (not including to)
+			auto history_write(int from,int to) -> void {
+#ifndef FERN_NO_HISTORY
+				if(to <= from) return;
+				m_emit.load(32,RAX,cpu(m_at.historyPos));
+				m_emit.load(32,RCX,cpu(m_at.rombank));
+				for(int i=std::max(from,to - fern::INSTRHISTORY_DEPTH); i<to; i++) {
+					m_emit.lea(32,RDX,mem_at(RAX,i - from));
+					m_emit.alu_imm(32,ALU_AND,RDX,fern::INSTRHISTORY_DEPTH - 1);
+					m_emit.store_imm(16,mem_at(HOST_CPU,RDX,4,m_at.history),m_block.instrs[i].pc);
+					m_emit.store(16,mem_at(HOST_CPU,RDX,4,m_at.history + 2),RCX);
+				}
+				m_emit.alu_memImm(32,ALU_ADD,cpu(m_at.historyPos),to - from);
+#endif
+			}
+			// takes back history written by a cold path that carries on
+			auto history_unwrite(int count) -> void {
+#ifndef FERN_NO_HISTORY
+				if(count > 0) m_emit.alu_memImm(32,ALU_SUB,cpu(m_at.historyPos),count);
+#endif
+			}
+			auto curop_set(int opcode) -> void {
+				m_emit.store_imm(8,cpu(m_at.curopcode),opcode);
+				m_emit.mov_ptr(RAX,m_calls.opcodes[opcode]);
+				m_emit.store(64,cpu(m_at.curopcodePtr),RAX);
+			}
+			auto clock_add(int cycles) -> void {
+				if(cycles) m_emit.alu_memImm(64,ALU_ADD,cpu(m_at.clockCycles),cycles);
+			}
+			auto clock_sub(int cycles) -> void {
+				if(cycles) m_emit.alu_memImm(64,ALU_SUB,cpu(m_at.clockCycles),cycles);
+			}
+			auto call_cpu(const void* fn) -> void {
+				m_emit.mov(64,REG_ARG0,HOST_CPU);
+				m_emit.mov_ptr(RAX,fn);
+				m_emit.call(RAX);
+			}
+			// what clock_reschedule() does: the next check runs clock_update()
+			auto clock_reschedule() -> void {
+				m_emit.store_imm(64,cpu(m_at.clockNextEvent),0);
+				m_emit.alu(32,ALU_XOR,HOST_BUDGET,HOST_BUDGET);
+			}
+			// what clock_tick() does once the clock's up to date
+			auto clock_check() -> void {
+				const int done = m_emit.label();
+				m_emit.load(64,RAX,cpu(m_at.clockCycles));
+				m_emit.alu_load(64,ALU_CMP,RAX,cpu(m_at.clockNextEvent));
+				m_emit.jcc(CC_C,done);
+				call_cpu(m_calls.clockUpdate);
+				m_emit.bind(done);
+			}
+			auto exit_with(int count) -> void {
+				m_emit.mov_imm(RAX,count);
+				m_emit.jmp(m_exit);
+			}
+			// leaves the block after count instructions, going to pc (or
+			// wherever m_PC's been set to, if it's -1)
+			auto exit_block(int count,int cycles,int pc) -> void {
+				spill();
+				if(pc >= 0) m_emit.store_imm(16,cpu(m_at.regPC),pc);
+				history_write(m_synced,count);
+				curop_set(m_block.instrs[count - 1].opcode);
+				clock_add(cycles);
+				clock_check();
+				exit_with(count);
+			}
+			// jumps to leave if the block can't carry on after instruction k:
+			// run_until() is stopping, or PC or the ROM bank changed.
+			auto continue_check(int k,int leave) -> void {
+				const auto& instr = m_block.instrs[k];
+				m_emit.alu_memImm(8,ALU_CMP,cpu(m_at.runStop),0);
+				m_emit.jcc(CC_NZ,leave);
+				m_emit.alu_memImm(16,ALU_CMP,cpu(m_at.regPC),(instr.pc + instr.length) & 0xFFFF);
+				m_emit.jcc(CC_NZ,leave);
+			}
+			// branches, halt and stop always end blocks, so they're last too
+			auto is_last(int k) -> bool {
+				return k + 1 == static_cast<int>(m_block.instrs.size());
+			}
+
+			// handlers ----------------------------------@/
+			// calls instruction k's handler, with everything in memory. cycles
+			// is how far behind the clock is, synced how much history's written.
+			auto handler_call(int k,int cycles,int synced) -> void {
+				const auto& instr = m_block.instrs[k];
+				spill();
+				m_emit.store_imm(16,cpu(m_at.regPC),instr.pc);
+				history_write(synced,k + 1);
+				curop_set(instr.opcode);
+				m_emit.mov_ptr(RAX,instr.bytes.data());
+				m_emit.store(64,cpu(m_at.pcbytes),RAX);
+				clock_add(cycles);
+				m_emit.load(32,RAX,cpu(m_at.rombank));
+				m_emit.store(32,mem_at(RSP,STACK_BANK),RAX);
+
+				m_emit.mov(64,REG_ARG0,HOST_CPU);
+				m_emit.mov_ptr(REG_ARG1,m_emu);
+				m_emit.mov_ptr(RAX,reinterpret_cast<const void*>(instr.fn));
+				m_emit.call(RAX);
+				m_emit.store_imm(64,cpu(m_at.pcbytes),0);
+#ifdef FERN_LAZY_FLAGS
+				call_cpu(m_calls.flagMaterialize);
+#endif
+			}
+			auto handler_continueCheck(int k,int leave) -> void {
+				continue_check(k,leave);
+				m_emit.load(32,RAX,cpu(m_at.rombank));
+				m_emit.alu_load(32,ALU_CMP,RAX,mem_at(RSP,STACK_BANK));
+				m_emit.jcc(CC_NZ,leave);
+			}
+			// an instruction that's always left to its handler
+			auto handler(int k) -> void {
+				handler_call(k,m_cycles,m_synced);
+				if(is_last(k)) {
+					exit_with(k + 1);
+					return;
+				}
+				const int leave = m_emit.label();
+				handler_continueCheck(k,leave);
+				m_emit.cold([this,leave,k]() {
+					m_emit.bind(leave);
+					exit_with(k + 1);
+				});
+				reload();
+				budget();
+				m_cycles = 0;
+				m_synced = k + 1;
+			}
+			// the handler as a slow path for instruction k, out of line. it
+			// comes back after the instruction (taking `cycles`) if it can.
+			auto handler_cold(int k,int cycles) -> int {
+				const int entry = m_emit.label();
+				const int before = m_cycles;
+				const int synced = m_synced;
+				const int after = m_after;
+				m_emit.cold([this,entry,k,cycles,before,synced,after]() {
+					m_emit.bind(entry);
+					handler_call(k,before,synced);
+					if(is_last(k)) {
+						exit_with(k + 1);
+						return;
+					}
+					const int leave = m_emit.label();
+					handler_continueCheck(k,leave);
+					// back to being relative to where the block started
+					clock_sub(before + cycles);
+					history_unwrite(k + 1 - synced);
+					reload();
+					budget();
+					m_emit.jmp(after);
+					m_emit.bind(leave);
+					exit_with(k + 1);
+				});
+				return entry;
+			}
+			// after instruction k, which ended at m_cycles: if that's reached
+			// the next event, brings the clock up to date and runs it.
+			auto event_check(int k) -> void {
+				const auto& instr = m_block.instrs[k];
+				const int next = (instr.pc + instr.length) & 0xFFFF;
+				const int opcode = instr.opcode;
+				const int stub = m_emit.label();
+				const int cycles = m_cycles;
+				const int synced = m_synced;
+				const int after = m_after;
+				m_emit.alu_imm(64,ALU_CMP,HOST_BUDGET,cycles);
+				m_emit.jcc(CC_BE,stub);
+				m_emit.cold([this,stub,k,next,opcode,cycles,synced,after]() {
+					m_emit.bind(stub);
+					spill();
+					m_emit.store_imm(16,cpu(m_at.regPC),next);
+					history_write(synced,k + 1);
+					curop_set(opcode);
+					clock_add(cycles);
+					clock_check();
+					const int leave = m_emit.label();
+					continue_check(k,leave);
+					clock_sub(cycles);
+					history_unwrite(k + 1 - synced);
+					reload();
+					budget();
+					m_emit.jmp(after);
+					m_emit.bind(leave);
+					exit_with(k + 1);
+				});
+				m_emit.bind(after);
+			}
+
+			// memory ------------------------------------@/
+			// marks RAM blocks stale if the write to eax's address (and the
+			// bytes after it) hit code, like blockcache_written().
+			auto ramcode_check(int span) -> void {
+				for(int i=0; i<span; i++) {
+					const int skip = m_emit.label();
+					const int unechoed = m_emit.label();
+					m_emit.lea(32,RCX,mem_at(RAX,i));
+					m_emit.alu_imm(32,ALU_CMP,RCX,0xC000);
+					m_emit.jcc(CC_C,skip);
+					m_emit.alu_imm(32,ALU_CMP,RCX,0xE000);
+					m_emit.jcc(CC_C,unechoed);
+					m_emit.alu_imm(32,ALU_CMP,RCX,0xFE00);
+					m_emit.jcc(CC_NC,unechoed);
+					m_emit.alu_imm(32,ALU_SUB,RCX,0x2000);
+					m_emit.bind(unechoed);
+					m_emit.alu_imm(32,ALU_SUB,RCX,0xC000);
+					m_emit.mov(32,RDX,RCX);
+					m_emit.shift(32,SH_SHR,RDX,3);
+					m_emit.alu_imm(32,ALU_AND,RCX,7);
+					m_emit.movzx_load(8,RDX,mem_at(HOST_CPU,RDX,1,m_at.ramCode));
+					m_emit.bt(RDX,RCX);
+					m_emit.jcc(CC_NC,skip);
+					m_emit.store_imm(8,cpu(m_at.ramDirty),1);
+					m_emit.bind(skip);
+				}
+			}
+			// same, for an address known now
+			auto ramcode_checkStatic(int addr,int span) -> void {
+				for(int i=0; i<span; i++) {
+					int a = addr + i;
+					if(a < 0xC000) continue;
+					if(a >= 0xE000 && a < 0xFE00) a -= 0x2000;
+					const int index = a - 0xC000;
+					const int skip = m_emit.label();
+					m_emit.op_rm(8,0xF6,0,cpu(m_at.ramCode + (index>>3)));
+					m_emit.u8(1<<(index & 7));
+					m_emit.jcc(CC_Z,skip);
+					m_emit.store_imm(8,cpu(m_at.ramDirty),1);
+					m_emit.bind(skip);
+				}
+			}
+			// eax = the address an access goes to
+			auto access_addr(const CJitAccess& a) -> void {
+				if(a.kind == ADDR_SP) {
+					m_emit.lea(32,RAX,mem_at(HOST_SP,a.addr));
+					m_emit.movzx(16,RAX,RAX);
+					return;
+				}
+				const int name = (a.kind == ADDR_HL) ? fern::RegisterName::H : (a.kind == ADDR_BC) ? fern::RegisterName::B : fern::RegisterName::D;
+				m_emit.mov(32,RAX,HOST_REGS[name]);
+				m_emit.shift(32,SH_SHL,RAX,8);
+				m_emit.alu(32,ALU_OR,RAX,HOST_REGS[name + 1]);
+			}
+			// jumps to slow unless HRAM's unwatched
+			auto hram_watchCheck(int slow) -> void {
+				m_emit.alu_memImm(8,ALU_CMP,cpu(m_at.watchPages + 0xFF),0);
+				m_emit.jcc(CC_NZ,slow);
+			}
+			// an access by instruction k (taking cycles) through body(operand).
+			// ROM and RAM pages are read and written directly, HRAM from
+			// m_hram, and anything else by calling the handler instead.
+			auto access(int k,int cycles,const CJitAccess& a,const CJitBody& body) -> void {
+				const int slow = handler_cold(k,cycles);
+				const int32_t hram_base = m_at.hram - 0xFF80;
+				const int32_t table = (a.write && !a.modify) ? m_at.pageWrite : m_at.pageRead;
+
+				if(a.kind == ADDR_ABS) {
+					if(a.addr >= 0xFF80) {
+						hram_watchCheck(slow);
+						body(cpu(hram_base + a.addr));
+					} else {
+						const int page = a.addr>>8;
+						m_emit.load(64,RDX,cpu(table + page*8));
+						m_emit.test(64,RDX,RDX);
+						m_emit.jcc(CC_Z,slow);
+						body(mem_at(RDX,a.addr & 0xFF));
+					}
+					if(a.write) ramcode_checkStatic(a.addr,a.span);
+					return;
+				}
+				if(a.kind == ADDR_C) {
+					const int reg = HOST_REGS[fern::RegisterName::C];
+					m_emit.alu_imm(32,ALU_CMP,reg,0x80);
+					m_emit.jcc(CC_C,slow);
+					m_emit.alu_imm(32,ALU_CMP,reg,0xFE);
+					m_emit.jcc(CC_A,slow);
+					hram_watchCheck(slow);
+					body(mem_at(HOST_CPU,reg,1,m_at.hram - 0x80));
+					if(a.write) {
+						m_emit.mov(32,RAX,reg);
+						m_emit.alu_imm(32,ALU_OR,RAX,0xFF00);
+						ramcode_check(1);
+					}
+					return;
+				}
+
+				// dynamic address: pages first, then HRAM out of line
+				const int hram = m_emit.label();
+				const int ramcode = m_emit.label();
+				const int join = m_emit.label();
+				CJitMem operand;
+				if(a.kind == ADDR_SP) {
+					access_addr(a);
+					if(a.span > 1) {
+						m_emit.alu_imm(8,ALU_CMP,RAX,0xFF); // crosses a page
+						m_emit.jcc(CC_Z,hram);
+					}
+					m_emit.movzx(8,RCX,RAX);
+					m_emit.shift(32,SH_SHR,RAX,8);
+					m_emit.load(64,RDX,mem_at(HOST_CPU,RAX,8,table));
+					operand = mem_at(RDX,RCX,1,0);
+				} else {
+					const int name = (a.kind == ADDR_HL) ? fern::RegisterName::H : (a.kind == ADDR_BC) ? fern::RegisterName::B : fern::RegisterName::D;
+					m_emit.load(64,RDX,mem_at(HOST_CPU,HOST_REGS[name],8,table));
+					operand = mem_at(RDX,HOST_REGS[name + 1],1,0);
+				}
+				m_emit.test(64,RDX,RDX);
+				m_emit.jcc(CC_Z,hram);
+				if(a.modify) {
+					// both ways have to go to the same place
+					const int name = (a.kind == ADDR_HL) ? fern::RegisterName::H : (a.kind == ADDR_BC) ? fern::RegisterName::B : fern::RegisterName::D;
+					m_emit.alu_load(64,ALU_CMP,RDX,mem_at(HOST_CPU,HOST_REGS[name],8,m_at.pageWrite));
+					m_emit.jcc(CC_NZ,hram);
+				}
+				body(operand);
+				if(a.write) {
+					if(a.kind == ADDR_SP) {
+						access_addr(a);
+						m_emit.alu_imm(32,ALU_CMP,RAX,0xC000);
+					} else {
+						const int name = (a.kind == ADDR_HL) ? fern::RegisterName::H : (a.kind == ADDR_BC) ? fern::RegisterName::B : fern::RegisterName::D;
+						m_emit.alu_imm(32,ALU_CMP,HOST_REGS[name],0xC0);
+					}
+					m_emit.jcc(CC_NC,ramcode);
+				}
+				m_emit.bind(join);
+
+				m_emit.cold([this,a,body,slow,hram,ramcode,join,hram_base]() {
+					m_emit.bind(hram);
+					access_addr(a);
+					m_emit.alu_imm(32,ALU_CMP,RAX,0xFF80);
+					m_emit.jcc(CC_C,slow);
+					m_emit.alu_imm(32,ALU_CMP,RAX,0xFFFF - a.span);
+					m_emit.jcc(CC_A,slow);
+					hram_watchCheck(slow);
+					body(mem_at(HOST_CPU,RAX,1,hram_base));
+					if(!a.write) {
+						m_emit.jmp(join);
+						return;
+					}
+					m_emit.bind(ramcode);
+					access_addr(a);
+					ramcode_check(a.span);
+					m_emit.jmp(join);
+				});
+			}
+			// a scratch register the operand doesn't use
+			static auto scratch(const CJitMem& m) -> int {
+				return (m.base != RAX && m.index != RAX) ? RAX : RCX;
+			}
+
+			// ALU ---------------------------------------@/
+			// F from the host flags: keeps keep's bits, adds set's
+			auto flags(int table,int keep,int set) -> void {
+				m_emit.lahf();
+				m_emit.movzx_ah();
+				m_emit.movzx_load(8,RAX,mem_at(HOST_FLAGTABLES,RAX,1,table * 0x100));
+				m_emit.alu_imm(32,ALU_AND,HOST_F,keep);
+				m_emit.alu(32,ALU_OR,HOST_F,RAX);
+				if(set) m_emit.alu_imm(32,ALU_OR,HOST_F,set);
+			}
+			// eax = (cond ? 1 : 0) << bit
+			auto flag_bit(int cc,int bit) -> void {
+				m_emit.setcc(cc,RAX);
+				m_emit.movzx(8,RAX,RAX);
+				if(bit) m_emit.shift(32,SH_SHL,RAX,bit);
+			}
+			// adc/sbc add the carry to the operand before working out H and C
+			// (see the adc/sbc handlers), so they're done the long way.
+			auto alu_carry(bool subtract,int src) -> void {
+				if(src != RCX) m_emit.mov(32,RCX,src);
+				m_emit.mov(32,RAX,HOST_F);
+				m_emit.shift(32,SH_SHR,RAX,4);
+				m_emit.alu_imm(32,ALU_AND,RAX,1);
+				m_emit.alu(32,ALU_ADD,RCX,RAX);
+				// H into edx
+				m_emit.mov(32,RDX,HOST_A);
+				m_emit.alu_imm(32,ALU_AND,RDX,0xF);
+				m_emit.mov(32,RAX,RCX);
+				m_emit.alu_imm(32,ALU_AND,RAX,0xF);
+				m_emit.alu(32,subtract ? ALU_SUB : ALU_ADD,RDX,RAX);
+				m_emit.alu_imm(32,ALU_AND,RDX,0x10);
+				m_emit.shift(32,SH_SHL,RDX,1);
+				// then C
+				if(subtract) {
+					m_emit.alu(32,ALU_CMP,RCX,HOST_A);
+					flag_bit(CC_A,4);
+					m_emit.alu(32,ALU_OR,RDX,RAX);
+					m_emit.alu(32,ALU_SUB,HOST_A,RCX);
+					m_emit.alu_imm(32,ALU_OR,RDX,0x40);
+				} else {
+					m_emit.alu(32,ALU_ADD,HOST_A,RCX);
+					m_emit.mov(32,RAX,HOST_A);
+					m_emit.shift(32,SH_SHR,RAX,4);
+					m_emit.alu_imm(32,ALU_AND,RAX,0x10);
+					m_emit.alu(32,ALU_OR,RDX,RAX);
+				}
+				m_emit.movzx(8,HOST_A,HOST_A);
+				m_emit.test(8,HOST_A,HOST_A);
+				flag_bit(CC_Z,7);
+				m_emit.alu(32,ALU_OR,RDX,RAX);
+				m_emit.alu_imm(32,ALU_AND,HOST_F,0x0F);
+				m_emit.alu(32,ALU_OR,HOST_F,RDX);
+			}
+			// A = A op src, ops in opcode order (add adc sub sbc and xor or cp)
+			auto alu_a(int op,int src) -> void {
+				switch(op) {
+					case 0: m_emit.alu(8,ALU_ADD,HOST_A,src); flags(FLAGS_ZHC,0x0F,0); break;
+					case 1: alu_carry(false,src); break;
+					case 2: m_emit.alu(8,ALU_SUB,HOST_A,src); flags(FLAGS_ZHC,0x0F,0x40); break;
+					case 3: alu_carry(true,src); break;
+					case 4: m_emit.alu(8,ALU_AND,HOST_A,src); flags(FLAGS_Z,0x0F,0x20); break;
+					case 5: m_emit.alu(8,ALU_XOR,HOST_A,src); flags(FLAGS_Z,0x0F,0); break;
+					case 6: m_emit.alu(8,ALU_OR,HOST_A,src); flags(FLAGS_Z,0x0F,0); break;
+					case 7:
+						m_emit.mov(32,RDX,HOST_A);
+						m_emit.alu(8,ALU_SUB,RDX,src);
+						flags(FLAGS_ZHC,0x0F,0x40);
+						break;
+				}
+			}
+			// the CB rotates/shifts/swap, by (op>>3)&7. shift() leaves the
+			// carry out in the host's CF for shift_flags().
+			auto cb_shift(int kind,int reg) -> void {
+				switch(kind) {
+					case 0: m_emit.shift(8,SH_ROL,reg,1); break;
+					case 1: m_emit.shift(8,SH_ROR,reg,1); break;
+					case 2: m_emit.bt_imm(HOST_F,4); m_emit.shift(8,SH_RCL,reg,1); break;
+					case 3: m_emit.bt_imm(HOST_F,4); m_emit.shift(8,SH_RCR,reg,1); break;
+					case 4: m_emit.shift(8,SH_SHL,reg,1); break;
+					case 5: m_emit.shift(8,SH_SAR,reg,1); break;
+					case 6: m_emit.shift(8,SH_ROL,reg,4); break;
+					case 7: m_emit.shift(8,SH_SHR,reg,1); break;
+				}
+			}
+			auto cb_shiftFlags(int kind,int reg) -> void {
+				if(kind == 6) {
+					m_emit.test(8,reg,reg);
+					flag_bit(CC_Z,7);
+					m_emit.mov(32,HOST_F,RAX);
+					return;
+				}
+				flag_bit(CC_C,0);
+				if(kind == 2 || kind == 4) {
+					// Z is for the result before it's cut to 8 bits (see
+					// the CB handler), so it needs the carry clear too
+					m_emit.mov(32,RDX,RAX);
+					m_emit.alu(8,ALU_OR,RDX,reg);
+				} else {
+					m_emit.test(8,reg,reg);
+				}
+				m_emit.setcc(CC_Z,RDX);
+				m_emit.movzx(8,RDX,RDX);
+				m_emit.shift(32,SH_SHL,RDX,7);
+				m_emit.shift(32,SH_SHL,RAX,4);
+				m_emit.alu(32,ALU_OR,RAX,RDX);
+				m_emit.mov(32,HOST_F,RAX);
+			}
+			auto cb_bitFlags(int reg,int bit) -> void {
+				m_emit.test_imm(8,reg,1<<bit);
+				flag_bit(CC_Z,7);
+				m_emit.alu_imm(32,ALU_AND,HOST_F,0x1F);
+				m_emit.alu(32,ALU_OR,HOST_F,RAX);
+				m_emit.alu_imm(32,ALU_OR,HOST_F,0x20);
+			}
+			// rlca/rrca/rla/rra: like the CB ones, but Z's always clear
+			auto rotate_a(int kind) -> void {
+				cb_shift(kind,HOST_A);
+				flag_bit(CC_C,4);
+				m_emit.mov(32,HOST_F,RAX);
+			}
+			// 16-bit inc/dec on a pair (or SP)
+			auto incdec16(int pair,bool dec) -> void {
+				if(pair == 3) {
+					m_emit.alu_imm(16,dec ? ALU_SUB : ALU_ADD,HOST_SP,1);
+					return;
+				}
+				m_emit.alu_imm(8,dec ? ALU_SUB : ALU_ADD,HOST_REGS[pair*2 + 1],1);
+				m_emit.alu_imm(8,dec ? ALU_SBB : ALU_ADC,HOST_REGS[pair*2],0);
+			}
+			auto add_hl(int pair) -> void {
+				const int h = HOST_REGS[fern::RegisterName::H];
+				const int l = HOST_REGS[fern::RegisterName::L];
+				m_emit.mov(32,RAX,h);
+				m_emit.shift(32,SH_SHL,RAX,8);
+				m_emit.alu(32,ALU_OR,RAX,l);
+				if(pair == 3) {
+					m_emit.mov(32,RCX,HOST_SP);
+				} else {
+					m_emit.mov(32,RCX,HOST_REGS[pair*2]);
+					m_emit.shift(32,SH_SHL,RCX,8);
+					m_emit.alu(32,ALU_OR,RCX,HOST_REGS[pair*2 + 1]);
+				}
+				// H is the carry into bit 12, C the carry out of bit 15
+				m_emit.mov(32,RDX,RAX);
+				m_emit.alu(32,ALU_XOR,RDX,RCX);
+				m_emit.alu(32,ALU_ADD,RAX,RCX);
+				m_emit.alu(32,ALU_XOR,RDX,RAX);
+				m_emit.shift(32,SH_SHR,RDX,7);
+				m_emit.alu_imm(32,ALU_AND,RDX,0x20);
+				m_emit.mov(32,RCX,RAX);
+				m_emit.shift(32,SH_SHR,RCX,12);
+				m_emit.alu_imm(32,ALU_AND,RCX,0x10);
+				m_emit.alu_imm(32,ALU_AND,HOST_F,0x8F);
+				m_emit.alu(32,ALU_OR,HOST_F,RDX);
+				m_emit.alu(32,ALU_OR,HOST_F,RCX);
+				m_emit.movzx(8,l,RAX);
+				m_emit.shift(32,SH_SHR,RAX,8);
+				m_emit.movzx(8,h,RAX);
+			}
+
+			// branches ----------------------------------@/
+			// jumps to taken if cond (nz z nc c) holds
+			auto branch_if(int cond,int taken) -> void {
+				m_emit.test_imm(8,HOST_F,(cond < 2) ? 0x80 : 0x10);
+				m_emit.jcc((cond & 1) ? CC_NZ : CC_Z,taken);
+			}
+			auto push_imm(int k,int cycles,int value) -> void {
+				access(k,cycles,{ ADDR_SP,-2,2,true,false },[this,value](const CJitMem& m) {
+					m_emit.store_imm(8,mem_next(m),value>>8);
+					m_emit.store_imm(8,m,value & 0xFF);
+				});
+				m_emit.alu_imm(16,ALU_SUB,HOST_SP,2);
+			}
+			// pops into m_PC
+			auto pop_pc(int k,int cycles) -> void {
+				access(k,cycles,{ ADDR_SP,0,2,false,false },[this](const CJitMem& m) {
+					const int value = scratch(m);
+					m_emit.movzx_load(16,value,m);
+					m_emit.store(16,cpu(m_at.regPC),value);
+				});
+				m_emit.alu_imm(16,ALU_ADD,HOST_SP,2);
+			}
+
+			// instructions ------------------------------@/
+			// native code for instruction k, if there is any: returns its
+			// cycles, -1 for branches (which exit the block themselves), or 0
+			// to leave it to the handler.
+			auto instr_native(int k) -> int {
+				const auto& instr = m_block.instrs[k];
+				const int op = instr.opcode;
+				const int n8 = instr.bytes[1];
+				const int n16 = instr.bytes[1] | (instr.bytes[2]<<8);
+				const int next = (instr.pc + instr.length) & 0xFFFF;
+				const int dst = (op>>3) & 7;
+				const int src = op & 7;
+				const int pair = (op>>4) & 3;
+				const int hi = HOST_REGS[pair*2];
+				const int lo = HOST_REGS[pair*2 + 1];
+				const int addr_pair[] = { ADDR_BC,ADDR_DE,ADDR_HL,ADDR_HL };
+
+				if(op == 0x76) return 0; // halt
+				// ld r,r' / ld r,[hl] / ld [hl],r
+				if(op >= 0x40 && op < 0x80) {
+					if(src == fern::RegisterName::HLData) {
+						const int reg = HOST_REGS[dst];
+						access(k,2,{ ADDR_HL,0,1,false,false },[this,reg](const CJitMem& m) {
+							m_emit.movzx_load(8,reg,m);
+						});
+						return 2;
+					}
+					if(dst == fern::RegisterName::HLData) {
+						const int reg = HOST_REGS[src];
+						access(k,2,{ ADDR_HL,0,1,true,false },[this,reg](const CJitMem& m) {
+							m_emit.store(8,m,reg);
+						});
+						return 2;
+					}
+					if(dst != src) m_emit.mov(32,HOST_REGS[dst],HOST_REGS[src]);
+					return 1;
+				}
+				// alu a,r / alu a,[hl] / alu a,n
+				if(op >= 0x80 && op < 0xC0) {
+					if(src != fern::RegisterName::HLData) {
+						alu_a(dst,HOST_REGS[src]);
+						return 1;
+					}
+					access(k,2,{ ADDR_HL,0,1,false,false },[this,dst](const CJitMem& m) {
+						m_emit.movzx_load(8,RCX,m);
+						alu_a(dst,RCX);
+					});
+					return 2;
+				}
+				if((op & 0xC7) == 0xC6) {
+					m_emit.mov_imm(RCX,n8);
+					alu_a(dst,RCX);
+					return 2;
+				}
+				// ld r,n / inc r / dec r
+				if(op < 0x40 && (src == 6 || src == 4 || src == 5)) {
+					if(dst != fern::RegisterName::HLData) {
+						const int reg = HOST_REGS[dst];
+						if(src == 6) {
+							m_emit.mov_imm(reg,n8);
+							return 2;
+						}
+						if(src == 4) m_emit.inc8(reg);
+						else m_emit.dec8(reg);
+						flags(FLAGS_ZH,0x1F,(src == 5) ? 0x40 : 0);
+						return 1;
+					}
+					if(src == 6) {
+						access(k,3,{ ADDR_HL,0,1,true,false },[this,n8](const CJitMem& m) {
+							m_emit.store_imm(8,m,n8);
+						});
+						return 3;
+					}
+					access(k,3,{ ADDR_HL,0,1,true,true },[this,src](const CJitMem& m) {
+						m_emit.movzx_load(8,RCX,m);
+						if(src == 4) m_emit.inc8(RCX);
+						else m_emit.dec8(RCX);
+						m_emit.store(8,m,RCX); // leaves the flags alone
+						flags(FLAGS_ZH,0x1F,(src == 5) ? 0x40 : 0);
+					});
+					return 3;
+				}
+
+				switch(op) {
+					case 0x00: return 1; // nop
+					case 0x01: case 0x11: case 0x21:
+						m_emit.mov_imm(hi,instr.bytes[2]);
+						m_emit.mov_imm(lo,instr.bytes[1]);
+						return 3;
+					case 0x31:
+						m_emit.mov_imm(HOST_SP,n16);
+						return 3;
+					case 0x03: case 0x13: case 0x23: case 0x33:
+					case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+						incdec16(pair,op & 0x08);
+						return 2;
+					case 0x09: case 0x19: case 0x29: case 0x39:
+						add_hl(pair);
+						return 2;
+
+					// ld [bc]/[de]/[hl+]/[hl-],a and back
+					case 0x02: case 0x12: case 0x22: case 0x32:
+						access(k,2,{ addr_pair[pair],0,1,true,false },[this](const CJitMem& m) {
+							m_emit.store(8,m,HOST_A);
+						});
+						if(pair >= 2) incdec16(2,pair == 3);
+						return 2;
+					case 0x0A: case 0x1A: case 0x2A: case 0x3A:
+						access(k,2,{ addr_pair[pair],0,1,false,false },[this](const CJitMem& m) {
+							m_emit.movzx_load(8,HOST_A,m);
+						});
+						if(pair >= 2) incdec16(2,pair == 3);
+						return 2;
+					case 0xE0: case 0xF0: case 0xEA: case 0xFA: {
+						const bool high = (op & 0x0F) == 0;
+						const int addr = high ? (0xFF00 | n8) : n16;
+						// IO, and the odd one that spans a page
+						if(addr >= 0xFF00 && (addr < 0xFF80 || addr == 0xFFFF)) return 0;
+						const bool write = (op & 0x10) == 0;
+						access(k,high ? 3 : 4,{ ADDR_ABS,addr,1,write,false },[this,write](const CJitMem& m) {
+							if(write) m_emit.store(8,m,HOST_A);
+							else m_emit.movzx_load(8,HOST_A,m);
+						});
+						return high ? 3 : 4;
+					}
+					case 0xE2:
+						access(k,2,{ ADDR_C,0,1,true,false },[this](const CJitMem& m) {
+							m_emit.store(8,m,HOST_A);
+						});
+						return 2;
+					case 0xF2:
+						access(k,2,{ ADDR_C,0,1,false,false },[this](const CJitMem& m) {
+							m_emit.movzx_load(8,HOST_A,m);
+						});
+						return 2;
+
+					// stack
+					case 0xC5: case 0xD5: case 0xE5: case 0xF5: {
+						const int push_hi = (pair == 3) ? HOST_A : hi;
+						const int push_lo = (pair == 3) ? HOST_F : lo;
+						access(k,4,{ ADDR_SP,-2,2,true,false },[this,push_hi,push_lo](const CJitMem& m) {
+							m_emit.store(8,mem_next(m),push_hi);
+							m_emit.store(8,m,push_lo);
+						});
+						m_emit.alu_imm(16,ALU_SUB,HOST_SP,2);
+						return 4;
+					}
+					case 0xC1: case 0xD1: case 0xE1: case 0xF1: {
+						const bool af = pair == 3;
+						access(k,3,{ ADDR_SP,0,2,false,false },[this,af,hi,lo](const CJitMem& m) {
+							const int value = scratch(m);
+							m_emit.movzx_load(16,value,m);
+							m_emit.movzx(8,af ? HOST_F : lo,value);
+							if(af) m_emit.alu_imm(32,ALU_AND,HOST_F,0xF0);
+							m_emit.shift(32,SH_SHR,value,8);
+							m_emit.mov(32,af ? HOST_A : hi,value);
+						});
+						m_emit.alu_imm(16,ALU_ADD,HOST_SP,2);
+						return 3;
+					}
+					case 0xF9:
+						m_emit.mov(32,HOST_SP,HOST_REGS[fern::RegisterName::H]);
+						m_emit.shift(32,SH_SHL,HOST_SP,8);
+						m_emit.alu(32,ALU_OR,HOST_SP,HOST_REGS[fern::RegisterName::L]);
+						return 2;
+
+					// A and F
+					case 0x07: rotate_a(0); return 1;
+					case 0x0F: rotate_a(1); return 1;
+					case 0x17: rotate_a(2); return 1;
+					case 0x1F: rotate_a(3); return 1;
+					case 0x2F:
+						m_emit.alu_imm(32,ALU_XOR,HOST_A,0xFF);
+						m_emit.alu_imm(32,ALU_OR,HOST_F,0x60);
+						return 1;
+					case 0x37:
+						m_emit.alu_imm(32,ALU_AND,HOST_F,0x8F);
+						m_emit.alu_imm(32,ALU_OR,HOST_F,0x10);
+						return 1;
+					case 0x3F:
+						m_emit.alu_imm(32,ALU_AND,HOST_F,0x9F);
+						m_emit.alu_imm(32,ALU_XOR,HOST_F,0x10);
+						return 1;
+					case 0xF3:
+						m_emit.store_imm(8,cpu(m_at.regIME),0);
+						return 1;
+					case 0xFB: // takes effect at the next instruction
+						m_emit.store_imm(8,cpu(m_at.shouldEnableIME),1);
+						clock_reschedule();
+						return 1;
+					case 0xCB:
+						return instr_cb(k,n8);
+
+					// branches
+					case 0x18:
+						exit_block(k + 1,m_cycles + 3,(next + static_cast<int8_t>(n8)) & 0xFFFF);
+						return -1;
+					case 0x20: case 0x28: case 0x30: case 0x38: {
+						const int taken = m_emit.label();
+						branch_if(dst & 3,taken);
+						exit_block(k + 1,m_cycles + 2,next);
+						m_emit.bind(taken);
+						exit_block(k + 1,m_cycles + 3,(next + static_cast<int8_t>(n8)) & 0xFFFF);
+						return -1;
+					}
+					case 0xC3:
+						exit_block(k + 1,m_cycles + 4,n16);
+						return -1;
+					case 0xC2: case 0xCA: case 0xD2: case 0xDA: {
+						const int taken = m_emit.label();
+						branch_if(dst & 3,taken);
+						exit_block(k + 1,m_cycles + 3,next);
+						m_emit.bind(taken);
+						exit_block(k + 1,m_cycles + 4,n16);
+						return -1;
+					}
+					case 0xE9:
+						m_emit.mov(32,RAX,HOST_REGS[fern::RegisterName::H]);
+						m_emit.shift(32,SH_SHL,RAX,8);
+						m_emit.alu(32,ALU_OR,RAX,HOST_REGS[fern::RegisterName::L]);
+						m_emit.store(16,cpu(m_at.regPC),RAX);
+						exit_block(k + 1,m_cycles + 1,-1);
+						return -1;
+					case 0xCD:
+						push_imm(k,6,next);
+						exit_block(k + 1,m_cycles + 6,n16);
+						return -1;
+					case 0xC4: case 0xCC: case 0xD4: case 0xDC: {
+						const int taken = m_emit.label();
+						branch_if(dst & 3,taken);
+						exit_block(k + 1,m_cycles + 3,next);
+						m_emit.bind(taken);
+						push_imm(k,6,next);
+						exit_block(k + 1,m_cycles + 6,n16);
+						return -1;
+					}
+					case 0xC9: case 0xD9:
+						pop_pc(k,4);
+						if(op == 0xD9) {
+							m_emit.store_imm(8,cpu(m_at.shouldEnableIME),1);
+							clock_reschedule();
+						}
+						exit_block(k + 1,m_cycles + 4,-1);
+						return -1;
+					case 0xC0: case 0xC8: case 0xD0: case 0xD8: {
+						const int taken = m_emit.label();
+						branch_if(dst & 3,taken);
+						exit_block(k + 1,m_cycles + 2,next);
+						m_emit.bind(taken);
+						pop_pc(k,5);
+						exit_block(k + 1,m_cycles + 5,-1);
+						return -1;
+					}
+					case 0xC7: case 0xCF: case 0xD7: case 0xDF:
+					case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+						push_imm(k,4,next);
+						exit_block(k + 1,m_cycles + 4,op & 0x38);
+						return -1;
+				}
+				// daa, ld [a16],sp, add sp,e, ld hl,sp+e, stop and the
+				// invalid ones
+				return 0;
+			}
+			auto instr_cb(int k,int cbop) -> int {
+				const int kind = (cbop>>3) & 7;
+				const int group = cbop>>6;
+				const int name = cbop & 7;
+				if(name != fern::RegisterName::HLData) {
+					const int reg = HOST_REGS[name];
+					if(group == 0) {
+						cb_shift(kind,reg);
+						cb_shiftFlags(kind,reg);
+					}
+					else if(group == 1) cb_bitFlags(reg,kind);
+					else if(group == 2) m_emit.alu_imm(32,ALU_AND,reg,0xFF ^ (1<<kind));
+					else m_emit.alu_imm(32,ALU_OR,reg,1<<kind);
+					return 2;
+				}
+				if(group == 1) {
+					access(k,3,{ ADDR_HL,0,1,false,false },[this,kind](const CJitMem& m) {
+						m_emit.movzx_load(8,RCX,m);
+						cb_bitFlags(RCX,kind);
+					});
+					return 3;
+				}
+				access(k,4,{ ADDR_HL,0,1,true,true },[this,kind,group](const CJitMem& m) {
+					if(group == 2) {
+						m_emit.alu_memImm(8,ALU_AND,m,0xFF ^ (1<<kind));
+					} else if(group == 3) {
+						m_emit.alu_memImm(8,ALU_OR,m,1<<kind);
+					} else {
+						m_emit.movzx_load(8,RCX,m);
+						cb_shift(kind,RCX);
+						m_emit.store(8,m,RCX); // leaves the flags alone
+						cb_shiftFlags(kind,RCX);
+					}
+				});
+				return 4;
+			}
+
+		public:
+			CJitCompiler(CJitEmitter& emit,const CJitLayout& at,const CJitCalls& calls,
+				const fern::CCPUBlock& block,fern::CEmulator* emu)
+				: m_emit(emit),m_at(at),m_calls(calls),m_block(block),m_emu(emu),
+				m_exit(0),m_after(0),m_cycles(0),m_synced(0)
+				{}
+
+			auto compile(const void* cpu_ptr) -> void {
+				const int saved[] = { RBX,RBP,RSI,RDI,R12,R13,R14,R15 };
+				for(auto reg : saved) m_emit.push(reg);
+				m_emit.alu_imm(64,ALU_SUB,RSP,40); // shadow space, the bank, and alignment
+				m_emit.mov_ptr(HOST_CPU,cpu_ptr);
+				m_emit.mov_ptr(HOST_FLAGTABLES,jit_flagTables.data());
+				reload();
+				budget();
+				m_exit = m_emit.label();
+
+				const int count = m_block.instrs.size();
+				for(int k=0; k<count; k++) {
+					const auto& instr = m_block.instrs[k];
+					m_after = m_emit.label();
+					if(k > 0 && m_block.instrs[k - 1].opcode == 0xFB) {
+						m_emit.store_imm(8,cpu(m_at.shouldEnableIME),0);
+						m_emit.store_imm(8,cpu(m_at.regIME),1);
+					}
+					const int cycles = instr_native(k);
+					if(cycles < 0) break;
+					if(cycles == 0) {
+						handler(k);
+						continue;
+					}
+					m_cycles += cycles;
+					if(k + 1 == count) {
+						exit_block(count,m_cycles,(instr.pc + instr.length) & 0xFFFF);
+						break;
+					}
+					event_check(k);
+				}
+
+				m_emit.bind(m_exit);
+				m_emit.alu_imm(64,ALU_ADD,RSP,40);
+				for(int i=7; i>=0; i--) m_emit.pop(saved[i]);
+				m_emit.ret();
+				m_emit.finish();
+			}
+	};
+}
+
+namespace fern {
+	CCPU::~CCPU() {
+		if(!m_jitBuffer) return;
+#ifdef _WIN32
+		VirtualFree(m_jitBuffer,0,MEM_RELEASE);
+#else
+		munmap(m_jitBuffer,JIT_BUFSIZE);
+#endif
+	}
+
+	auto CCPU::jit_clockUpdate(CCPU* cpu) -> void {
+		cpu->clock_update();
+	}
+#ifdef FERN_LAZY_FLAGS
+	auto CCPU::jit_flagMaterialize(CCPU* cpu) -> void {
+		cpu->flag_materialize();
+	}
+#endif
+
+	// drops all compiled code, the blocks stay.
+	auto CCPU::jit_flush() -> void {
+		for(auto& [key,block] : m_blockcacheRom) {
+			block.hits = 0;
+			block.jitfn = nullptr;
+		}
+		m_jitUsed = 0;
+	}
+
+	auto CCPU::jit_compile(const CCPUBlock& block) -> CCPUJitFn {
+		if(!m_jitBuffer) {
+#ifdef _WIN32
+			void* buffer = VirtualAlloc(nullptr,JIT_BUFSIZE,MEM_COMMIT | MEM_RESERVE,PAGE_EXECUTE_READWRITE);
+#else
+			void* buffer = mmap(nullptr,JIT_BUFSIZE,PROT_READ | PROT_WRITE | PROT_EXEC,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+			if(buffer == MAP_FAILED) buffer = nullptr;
+#endif
+			if(!buffer) {
+				std::puts("error: couldn't allocate JIT buffer");
+				std::exit(-1);
+			}
+			m_jitBuffer = static_cast<uint8_t*>(buffer);
+			m_jitUsed = 0;
+		}
+
+		auto& mem = m_emu->mem;
+		const auto offset = [this](const void* ptr) -> int32_t {
+			const intptr_t diff = reinterpret_cast<intptr_t>(ptr) - reinterpret_cast<intptr_t>(this);
+			if(diff < INT32_MIN / 2 || diff > INT32_MAX / 2) {
+				std::puts("error: JIT can't reach the emulator's state");
+				std::exit(-1);
+			}
+			return diff;
+		};
+		CJitLayout at;
+		const uint8_t* const regs[8] = {
+			&m_regB,&m_regC,&m_regD,&m_regE,
+			&m_regH,&m_regL,nullptr,&m_regA
+		};
+		for(int r=0; r<8; r++) at.regs[r] = regs[r] ? offset(regs[r]) : 0;
+		at.regF = offset(&m_regF);
+		at.regSP = offset(&m_SP);
+		at.regPC = offset(&m_PC);
+		at.regIME = offset(&m_regIME);
+		at.shouldEnableIME = offset(&m_should_enableIME);
+		at.curopcode = offset(&m_curopcode);
+		at.curopcodePtr = offset(&m_curopcode_ptr);
+		at.pcbytes = offset(&m_pcbytes);
+		at.clockCycles = offset(&m_clockCycles);
+		at.clockNextEvent = offset(&m_clockNextEvent);
+		at.runStop = offset(&m_runStop);
+#ifndef FERN_NO_HISTORY
+		static_assert(sizeof(CInstrHistoryData) == 4);
+		at.history = offset(m_instrhistory.data());
+		at.historyPos = offset(&m_instrhistoryPos);
+#endif
+		at.pageRead = offset(mem.m_pageRead.data());
+		at.pageWrite = offset(mem.m_pageWrite.data());
+		at.watchPages = offset(mem.m_watchPages.data());
+		at.hram = offset(mem.m_hram.data());
+		at.rombank = offset(&mem.m_rombankLatched);
+		at.ramCode = offset(m_blockcacheRamCode.data());
+		at.ramDirty = offset(&m_blockcacheRamDirty);
+
+		CJitCalls calls;
+		calls.clockUpdate = reinterpret_cast<const void*>(&CCPU::jit_clockUpdate);
+#ifdef FERN_LAZY_FLAGS
+		calls.flagMaterialize = reinterpret_cast<const void*>(&CCPU::jit_flagMaterialize);
+#else
+		calls.flagMaterialize = nullptr;
+#endif
+		for(int op=0; op<0x100; op++) calls.opcodes[op] = &m_opcodetable[op];
+
+		CJitEmitter emit(m_jitBuffer + m_jitUsed,JIT_BUFSIZE - m_jitUsed);
+		CJitCompiler compiler(emit,at,calls,block,m_emu);
+		compiler.compile(this);
+
+		// out of space: start over, the block gets compiled again once hot
+		if(emit.overflowed()) {
+			jit_flush();
+			return nullptr;
+		}
+		auto fn = reinterpret_cast<CCPUJitFn>(m_jitBuffer + m_jitUsed);
+		m_jitUsed += (emit.pos() + 15) & ~15;
+		return fn;
+	}
+}
+
+#endif
@@ -0,0 +1,479 @@
+#include <fern.h>
+#include <fern_common.h>
+
+// threaded interpreter core ------------------------------------------------@/
+// built in place of the table core's CCPU::run() when FERN_CPUCORE_THREADED is
+// defined. all 256 opcodes are dispatched from one loop: with computed goto
+// on GCC/clang (each handler jumps straight to the next one), or a switch
+// everywhere else. registers are kept in locals for the whole run slice, and
+// only written back to the CCPU when something outside the core could see
+// them (clock ticks, memory writes, and table fallbacks).
+// opcodes that aren't worth inlining (CB prefix, daa, stop...) fall back to
+// the regular opcode table, so both cores behave exactly the same.
+#ifdef FERN_CPUCORE_THREADED
+
+// FERN_NO_COMPUTED_GOTO forces the switch, for comparing the two.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(FERN_NO_COMPUTED_GOTO)
+	#define FERN_COMPUTED_GOTO
+#endif
+
+// register access ----------------------------------------------------------@/
+#define REG_BC() ((B<<8) | C)
+#define REG_DE() ((D<<8) | E)
+#define REG_HL() ((H<<8) | L)
+#define SET_BC(n) { int num_ = (n); C = num_ & 0xFF; B = (num_>>8) & 0xFF; }
+#define SET_DE(n) { int num_ = (n); E = num_ & 0xFF; D = (num_>>8) & 0xFF; }
+#define SET_HL(n) { int num_ = (n); L = num_ & 0xFF; H = (num_>>8) & 0xFF; }
+
+#define FLAG_Z() ((F>>7)&1)
+#define FLAG_C() ((F>>4)&1)
+#define FLAGS_SET(z,n,hc,cy) { F = ((z)<<7) | ((n)<<6) | ((hc)<<5) | ((cy)<<4); }
+
+// syncing with the CCPU ----------------------------------------------------@/
+// F goes through reg_f()/f_set(), so lazy flags get worked out on the way in.
+#define SYNC_STORE() { \
+	m_regA = A; f_set(F); m_regB = B; m_regC = C; \
+	m_regD = D; m_regE = E; m_regH = H; m_regL = L; \
+	m_PC = PC; m_SP = SP; \
+}
+#define SYNC_LOAD() { \
+	A = m_regA; F = reg_f(); B = m_regB; C = m_regC; \
+	D = m_regD; E = m_regE; H = m_regH; L = m_regL; \
+	PC = m_PC; SP = m_SP; \
+}
+// clock ticks can only move PC/SP (interrupts), so only those are synced.
+#define TICK(n) { \
+	m_PC = PC; m_SP = SP; \
+	clock_tick(n); \
+	PC = m_PC; SP = m_SP; \
+}
+#define READ(addr) mem.read(addr)
+#define READ_PC(offset) mem.read(PC + (offset))
+#define READ_PC16(offset) (READ_PC(offset) | (READ_PC((offset)+1)<<8))
+// writes can start DMAs (which tick the clock) or print the CPU status.
+#define WRITE(addr,data) { \
+	SYNC_STORE(); \
+	mem.write((addr),(data)); \
+	PC = m_PC; SP = m_SP; \
+}
+
+#define PUSH16(n) { \
+	int data_ = (n) & 0xFFFF; \
+	SP -= 1; WRITE(SP,data_>>8); \
+	SP -= 1; WRITE(SP,data_ & 0xFF); \
+}
+#define POP16(out) { \
+	out = READ(SP) | (READ(SP+1)<<8); \
+	SP += 2; \
+}
+
+// ALU ----------------------------------------------------------------------@/
+#define ALU_ADD(operand) { \
+	int opB = (operand); \
+	int res_nyb = (A & 0xF) + (opB & 0xF); \
+	int result = A + opB; \
+	A = result; \
+	FLAGS_SET((result & 0xFF) == 0,0,(res_nyb & 0x10) == 0x10,result > 255); \
+}
+#define ALU_ADC(operand) ALU_ADD((operand) + FLAG_C())
+#define ALU_SUB(operand) { \
+	int opB = (operand); \
+	int res_nyb = (A & 0xF) - (opB & 0xF); \
+	int result = A - opB; \
+	bool carry = opB > A; \
+	A = result; \
+	FLAGS_SET((result & 0xFF) == 0,1,(res_nyb & 0x10) == 0x10,carry); \
+}
+#define ALU_SBC(operand) ALU_SUB((operand) + FLAG_C())
+#define ALU_AND(operand) { A &= (operand); FLAGS_SET(A == 0,0,1,0); }
+#define ALU_XOR(operand) { A ^= (operand); FLAGS_SET(A == 0,0,0,0); }
+#define ALU_OR(operand) { A |= (operand); FLAGS_SET(A == 0,0,0,0); }
+#define ALU_CP(operand) { \
+	int opB = (operand); \
+	int result = A - opB; \
+	int res_nyb = (A & 0xF) - (opB & 0xF); \
+	FLAGS_SET((result & 0xFF) == 0,1,(res_nyb & 0x10) == 0x10,opB > A); \
+}
+#define ALU_INC(reg) { \
+	int res_nyb = (reg & 0xF) + 1; \
+	reg += 1; \
+	F = (F & 0x10) | ((reg == 0)<<7) | (((res_nyb & 0x10) == 0x10)<<5); \
+}
+#define ALU_DEC(reg) { \
+	int res_nyb = (reg & 0xF) - 1; \
+	reg -= 1; \
+	F = (F & 0x10) | ((reg == 0)<<7) | (1<<6) | (((res_nyb & 0x10) == 0x10)<<5); \
+}
+#define ALU_ADDHL(operand) { \
+	uint32_t opA = REG_HL(); \
+	uint32_t opB = (operand); \
+	uint32_t res_4b = (opA & 0xFFF) + (opB & 0xFFF); \
+	F = (F & 0x80) | (((res_4b & 0x1000) == 0x1000)<<5) | ((opA + opB > 0xFFFF)<<4); \
+	SET_HL(opA + opB); \
+}
+
+// dispatch -----------------------------------------------------------------@/
+// FETCH() ends the slice when it runs out (or at a breakpoint), and does
+// what step() and execute_opcode() do for the table core.
+#define FETCH() { \
+	if(instrs_left <= 0 || m_runStop) goto slice_end; \
+	if(break_check(PC)) goto slice_end; \
+	instrs_left -= 1; \
+	if(m_should_enableIME) { \
+		m_should_enableIME = false; \
+		m_regIME = true; \
+	} \
+	opcode = READ(PC); \
+	instrhistory_push(mem.m_rombankLatched,PC); \
+	profile_begin(opcode,PC); \
+	if(trace_enabled()) { SYNC_STORE(); trace_record(PC); } \
+	m_curopcode = opcode; \
+	m_curopcode_ptr = &m_opcodetable[opcode]; \
+}
+#ifdef FERN_COMPUTED_GOTO
+	#define OPCODE(num) op_##num:
+	#define NEXT() { FETCH(); goto *optable[opcode]; }
+#else
+	#define OPCODE(num) case num:
+	#define NEXT() continue
+#endif
+// runs the opcode through the regular table.
+#define OP_FALLBACK(num) OPCODE(num) { \
+	SYNC_STORE(); \
+	opcode_run(opcode); \
+	SYNC_LOAD(); \
+	NEXT(); \
+}
+
+// opcode groups ------------------------------------------------------------@/
+#define OP_LD_R_R(num,dst,src) OPCODE(num) { \
+	dst = src; PC += 1; TICK(1); NEXT(); \
+}
+#define OP_LD_R_HL(num,dst) OPCODE(num) { \
+	dst = READ(REG_HL()); PC += 1; TICK(2); NEXT(); \
+}
+#define OP_LD_HL_R(num,src) OPCODE(num) { \
+	WRITE(REG_HL(),src); PC += 1; TICK(2); NEXT(); \
+}
+#define OP_LD_R_IMM8(num,dst) OPCODE(num) { \
+	dst = READ_PC(1); PC += 2; TICK(2); NEXT(); \
+}
+#define OP_ALU_R(num,oper,src) OPCODE(num) { \
+	ALU_##oper(src); PC += 1; TICK(1); NEXT(); \
+}
+#define OP_ALU_HL(num,oper) OPCODE(num) { \
+	ALU_##oper(READ(REG_HL())); PC += 1; TICK(2); NEXT(); \
+}
+#define OP_ALU_IMM8(num,oper) OPCODE(num) { \
+	ALU_##oper(READ_PC(1)); PC += 2; TICK(2); NEXT(); \
+}
+#define OP_INC_R(num,reg) OPCODE(num) { \
+	ALU_INC(reg); PC += 1; TICK(1); NEXT(); \
+}
+#define OP_DEC_R(num,reg) OPCODE(num) { \
+	ALU_DEC(reg); PC += 1; TICK(1); NEXT(); \
+}
+// backward jrs might be idle loops.
+#define OP_JR_COND(num,cond) OPCODE(num) { \
+	if(cond) { \
+		const int jr_pc = PC; \
+		PC += static_cast<int8_t>(READ_PC(1)); \
+		PC += 2; TICK(3); \
+		if(PC <= jr_pc) { \
+			SYNC_STORE(); \
+			instrs_left -= idle_skip(jr_pc,instrs_left); \
+		} \
+	} else { \
+		PC += 2; TICK(2); \
+	} \
+	NEXT(); \
+}
+#define OP_JP_COND(num,cond) OPCODE(num) { \
+	if(cond) { \
+		PC = READ_PC16(1); TICK(4); \
+	} else { \
+		PC += 3; TICK(3); \
+	} \
+	NEXT(); \
+}
+#define OP_CALL_COND(num,cond) OPCODE(num) { \
+	if(cond) { \
+		int addr = READ_PC16(1); \
+		PUSH16(PC+3); \
+		profile_call(addr,SP); \
+		PC = addr; TICK(6); \
+	} else { \
+		PC += 3; TICK(3); \
+	} \
+	NEXT(); \
+}
+#define OP_RET_COND(num,cond) OPCODE(num) { \
+	if(cond) { \
+		POP16(PC); profile_return(SP); TICK(5); \
+	} else { \
+		PC += 1; TICK(2); \
+	} \
+	NEXT(); \
+}
+#define OP_RST(num,vector) OPCODE(num) { \
+	PUSH16(PC+1); \
+	profile_call(vector,SP); \
+	PC = vector; TICK(4); \
+	NEXT(); \
+}
+#define OP_PUSH(num,data) OPCODE(num) { \
+	PUSH16(data); PC += 1; TICK(4); NEXT(); \
+}
+#define OP_POP(num,setter) OPCODE(num) { \
+	int data; \
+	POP16(data); setter(data); PC += 1; TICK(3); NEXT(); \
+}
+
+namespace fern {
+	auto CCPU::run(int instr_count) -> void {
+		auto& mem = m_emu->mem;
+		int instrs_left = instr_count;
+		int opcode = 0;
+
+		uint8_t A,F,B,C,D,E,H,L;
+		uint16_t PC,SP;
+		SYNC_LOAD();
+
+#ifdef FERN_COMPUTED_GOTO
+		static void* const optable[0x100] = {
+			&&op_0x00,&&op_0x01,&&op_0x02,&&op_0x03,&&op_0x04,&&op_0x05,&&op_0x06,&&op_0x07,
+			&&op_0x08,&&op_0x09,&&op_0x0A,&&op_0x0B,&&op_0x0C,&&op_0x0D,&&op_0x0E,&&op_0x0F,
+			&&op_0x10,&&op_0x11,&&op_0x12,&&op_0x13,&&op_0x14,&&op_0x15,&&op_0x16,&&op_0x17,
+			&&op_0x18,&&op_0x19,&&op_0x1A,&&op_0x1B,&&op_0x1C,&&op_0x1D,&&op_0x1E,&&op_0x1F,
+			&&op_0x20,&&op_0x21,&&op_0x22,&&op_0x23,&&op_0x24,&&op_0x25,&&op_0x26,&&op_0x27,
+			&&op_0x28,&&op_0x29,&&op_0x2A,&&op_0x2B,&&op_0x2C,&&op_0x2D,&&op_0x2E,&&op_0x2F,
+			&&op_0x30,&&op_0x31,&&op_0x32,&&op_0x33,&&op_0x34,&&op_0x35,&&op_0x36,&&op_0x37,
+			&&op_0x38,&&op_0x39,&&op_0x3A,&&op_0x3B,&&op_0x3C,&&op_0x3D,&&op_0x3E,&&op_0x3F,
+			&&op_0x40,&&op_0x41,&&op_0x42,&&op_0x43,&&op_0x44,&&op_0x45,&&op_0x46,&&op_0x47,
+			&&op_0x48,&&op_0x49,&&op_0x4A,&&op_0x4B,&&op_0x4C,&&op_0x4D,&&op_0x4E,&&op_0x4F,
+			&&op_0x50,&&op_0x51,&&op_0x52,&&op_0x53,&&op_0x54,&&op_0x55,&&op_0x56,&&op_0x57,
+			&&op_0x58,&&op_0x59,&&op_0x5A,&&op_0x5B,&&op_0x5C,&&op_0x5D,&&op_0x5E,&&op_0x5F,
+			&&op_0x60,&&op_0x61,&&op_0x62,&&op_0x63,&&op_0x64,&&op_0x65,&&op_0x66,&&op_0x67,
+			&&op_0x68,&&op_0x69,&&op_0x6A,&&op_0x6B,&&op_0x6C,&&op_0x6D,&&op_0x6E,&&op_0x6F,
+			&&op_0x70,&&op_0x71,&&op_0x72,&&op_0x73,&&op_0x74,&&op_0x75,&&op_0x76,&&op_0x77,
+			&&op_0x78,&&op_0x79,&&op_0x7A,&&op_0x7B,&&op_0x7C,&&op_0x7D,&&op_0x7E,&&op_0x7F,
+			&&op_0x80,&&op_0x81,&&op_0x82,&&op_0x83,&&op_0x84,&&op_0x85,&&op_0x86,&&op_0x87,
+			&&op_0x88,&&op_0x89,&&op_0x8A,&&op_0x8B,&&op_0x8C,&&op_0x8D,&&op_0x8E,&&op_0x8F,
+			&&op_0x90,&&op_0x91,&&op_0x92,&&op_0x93,&&op_0x94,&&op_0x95,&&op_0x96,&&op_0x97,
+			&&op_0x98,&&op_0x99,&&op_0x9A,&&op_0x9B,&&op_0x9C,&&op_0x9D,&&op_0x9E,&&op_0x9F,
+			&&op_0xA0,&&op_0xA1,&&op_0xA2,&&op_0xA3,&&op_0xA4,&&op_0xA5,&&op_0xA6,&&op_0xA7,
+			&&op_0xA8,&&op_0xA9,&&op_0xAA,&&op_0xAB,&&op_0xAC,&&op_0xAD,&&op_0xAE,&&op_0xAF,
+			&&op_0xB0,&&op_0xB1,&&op_0xB2,&&op_0xB3,&&op_0xB4,&&op_0xB5,&&op_0xB6,&&op_0xB7,
+			&&op_0xB8,&&op_0xB9,&&op_0xBA,&&op_0xBB,&&op_0xBC,&&op_0xBD,&&op_0xBE,&&op_0xBF,
+			&&op_0xC0,&&op_0xC1,&&op_0xC2,&&op_0xC3,&&op_0xC4,&&op_0xC5,&&op_0xC6,&&op_0xC7,
+			&&op_0xC8,&&op_0xC9,&&op_0xCA,&&op_0xCB,&&op_0xCC,&&op_0xCD,&&op_0xCE,&&op_0xCF,
+			&&op_0xD0,&&op_0xD1,&&op_0xD2,&&op_0xD3,&&op_0xD4,&&op_0xD5,&&op_0xD6,&&op_0xD7,
+			&&op_0xD8,&&op_0xD9,&&op_0xDA,&&op_0xDB,&&op_0xDC,&&op_0xDD,&&op_0xDE,&&op_0xDF,
+			&&op_0xE0,&&op_0xE1,&&op_0xE2,&&op_0xE3,&&op_0xE4,&&op_0xE5,&&op_0xE6,&&op_0xE7,
+			&&op_0xE8,&&op_0xE9,&&op_0xEA,&&op_0xEB,&&op_0xEC,&&op_0xED,&&op_0xEE,&&op_0xEF,
+			&&op_0xF0,&&op_0xF1,&&op_0xF2,&&op_0xF3,&&op_0xF4,&&op_0xF5,&&op_0xF6,&&op_0xF7,
+			&&op_0xF8,&&op_0xF9,&&op_0xFA,&&op_0xFB,&&op_0xFC,&&op_0xFD,&&op_0xFE,&&op_0xFF,
+		};
+		NEXT();
+#else
+		for(;;) {
+		FETCH();
+		switch(opcode) {
+#endif
+
+		// loads --------------------------------------------@/
+		OP_LD_R_R(0x40,B,B) OP_LD_R_R(0x41,B,C) OP_LD_R_R(0x42,B,D) OP_LD_R_R(0x43,B,E)
+		OP_LD_R_R(0x44,B,H) OP_LD_R_R(0x45,B,L) OP_LD_R_HL(0x46,B)  OP_LD_R_R(0x47,B,A)
+		OP_LD_R_R(0x48,C,B) OP_LD_R_R(0x49,C,C) OP_LD_R_R(0x4A,C,D) OP_LD_R_R(0x4B,C,E)
+		OP_LD_R_R(0x4C,C,H) OP_LD_R_R(0x4D,C,L) OP_LD_R_HL(0x4E,C)  OP_LD_R_R(0x4F,C,A)
+		OP_LD_R_R(0x50,D,B) OP_LD_R_R(0x51,D,C) OP_LD_R_R(0x52,D,D) OP_LD_R_R(0x53,D,E)
+		OP_LD_R_R(0x54,D,H) OP_LD_R_R(0x55,D,L) OP_LD_R_HL(0x56,D)  OP_LD_R_R(0x57,D,A)
+		OP_LD_R_R(0x58,E,B) OP_LD_R_R(0x59,E,C) OP_LD_R_R(0x5A,E,D) OP_LD_R_R(0x5B,E,E)
+		OP_LD_R_R(0x5C,E,H) OP_LD_R_R(0x5D,E,L) OP_LD_R_HL(0x5E,E)  OP_LD_R_R(0x5F,E,A)
+		OP_LD_R_R(0x60,H,B) OP_LD_R_R(0x61,H,C) OP_LD_R_R(0x62,H,D) OP_LD_R_R(0x63,H,E)
+		OP_LD_R_R(0x64,H,H) OP_LD_R_R(0x65,H,L) OP_LD_R_HL(0x66,H)  OP_LD_R_R(0x67,H,A)
+		OP_LD_R_R(0x68,L,B) OP_LD_R_R(0x69,L,C) OP_LD_R_R(0x6A,L,D) OP_LD_R_R(0x6B,L,E)
+		OP_LD_R_R(0x6C,L,H) OP_LD_R_R(0x6D,L,L) OP_LD_R_HL(0x6E,L)  OP_LD_R_R(0x6F,L,A)
+		OP_LD_HL_R(0x70,B)  OP_LD_HL_R(0x71,C)  OP_LD_HL_R(0x72,D)  OP_LD_HL_R(0x73,E)
+		OP_LD_HL_R(0x74,H)  OP_LD_HL_R(0x75,L)                      OP_LD_HL_R(0x77,A)
+		OP_LD_R_R(0x78,A,B) OP_LD_R_R(0x79,A,C) OP_LD_R_R(0x7A,A,D) OP_LD_R_R(0x7B,A,E)
+		OP_LD_R_R(0x7C,A,H) OP_LD_R_R(0x7D,A,L) OP_LD_R_HL(0x7E,A)  OP_LD_R_R(0x7F,A,A)
+
+		OP_LD_R_IMM8(0x06,B) OP_LD_R_IMM8(0x0E,C) OP_LD_R_IMM8(0x16,D) OP_LD_R_IMM8(0x1E,E)
+		OP_LD_R_IMM8(0x26,H) OP_LD_R_IMM8(0x2E,L) OP_LD_R_IMM8(0x3E,A)
+
+		OPCODE(0x01) { C = READ_PC(1); B = READ_PC(2); PC += 3; TICK(3); NEXT(); }
+		OPCODE(0x11) { E = READ_PC(1); D = READ_PC(2); PC += 3; TICK(3); NEXT(); }
+		OPCODE(0x21) { L = READ_PC(1); H = READ_PC(2); PC += 3; TICK(3); NEXT(); }
+		OPCODE(0x31) { SP = READ_PC16(1); PC += 3; TICK(3); NEXT(); }
+		OPCODE(0x08) { // ld [a16],sp
+			int addr = READ_PC16(1);
+			WRITE(addr+0,SP & 0xFF);
+			WRITE(addr+1,(SP>>8) & 0xFF);
+			PC += 3; TICK(5); NEXT();
+		}
+		OPCODE(0xF9) { SP = REG_HL(); PC += 1; TICK(2); NEXT(); }
+
+		OPCODE(0x0A) { A = READ(REG_BC()); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x1A) { A = READ(REG_DE()); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x02) { WRITE(REG_BC(),A); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x12) { WRITE(REG_DE(),A); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x2A) { A = READ(REG_HL()); SET_HL(REG_HL() + 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x3A) { A = READ(REG_HL()); SET_HL(REG_HL() - 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x22) { WRITE(REG_HL(),A); SET_HL(REG_HL() + 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x32) { WRITE(REG_HL(),A); SET_HL(REG_HL() - 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x36) { WRITE(REG_HL(),READ_PC(1)); PC += 2; TICK(3); NEXT(); }
+
+		OPCODE(0xEA) { WRITE(READ_PC16(1),A); PC += 3; TICK(4); NEXT(); }
+		OPCODE(0xFA) { A = READ(READ_PC16(1)); PC += 3; TICK(4); NEXT(); }
+		OPCODE(0xE0) { WRITE(0xFF00 + READ_PC(1),A); PC += 2; TICK(3); NEXT(); }
+		OPCODE(0xF0) { A = READ(0xFF00 + READ_PC(1)); PC += 2; TICK(3); NEXT(); }
+		OPCODE(0xE2) { WRITE(0xFF00 + C,A); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0xF2) { A = READ(0xFF00 + C); PC += 1; TICK(2); NEXT(); }
+
+		// arithmetic ---------------------------------------@/
+		OP_ALU_R(0x80,ADD,B) OP_ALU_R(0x81,ADD,C) OP_ALU_R(0x82,ADD,D) OP_ALU_R(0x83,ADD,E)
+		OP_ALU_R(0x84,ADD,H) OP_ALU_R(0x85,ADD,L) OP_ALU_HL(0x86,ADD) OP_ALU_R(0x87,ADD,A)
+		OP_ALU_R(0x88,ADC,B) OP_ALU_R(0x89,ADC,C) OP_ALU_R(0x8A,ADC,D) OP_ALU_R(0x8B,ADC,E)
+		OP_ALU_R(0x8C,ADC,H) OP_ALU_R(0x8D,ADC,L) OP_ALU_HL(0x8E,ADC) OP_ALU_R(0x8F,ADC,A)
+		OP_ALU_R(0x90,SUB,B) OP_ALU_R(0x91,SUB,C) OP_ALU_R(0x92,SUB,D) OP_ALU_R(0x93,SUB,E)
+		OP_ALU_R(0x94,SUB,H) OP_ALU_R(0x95,SUB,L) OP_ALU_HL(0x96,SUB) OP_ALU_R(0x97,SUB,A)
+		OP_ALU_R(0x98,SBC,B) OP_ALU_R(0x99,SBC,C) OP_ALU_R(0x9A,SBC,D) OP_ALU_R(0x9B,SBC,E)
+		OP_ALU_R(0x9C,SBC,H) OP_ALU_R(0x9D,SBC,L) OP_ALU_HL(0x9E,SBC) OP_ALU_R(0x9F,SBC,A)
+		OP_ALU_R(0xA0,AND,B) OP_ALU_R(0xA1,AND,C) OP_ALU_R(0xA2,AND,D) OP_ALU_R(0xA3,AND,E)
+		OP_ALU_R(0xA4,AND,H) OP_ALU_R(0xA5,AND,L) OP_ALU_HL(0xA6,AND) OP_ALU_R(0xA7,AND,A)
+		OP_ALU_R(0xA8,XOR,B) OP_ALU_R(0xA9,XOR,C) OP_ALU_R(0xAA,XOR,D) OP_ALU_R(0xAB,XOR,E)
+		OP_ALU_R(0xAC,XOR,H) OP_ALU_R(0xAD,XOR,L) OP_ALU_HL(0xAE,XOR) OP_ALU_R(0xAF,XOR,A)
+		OP_ALU_R(0xB0,OR,B)  OP_ALU_R(0xB1,OR,C)  OP_ALU_R(0xB2,OR,D)  OP_ALU_R(0xB3,OR,E)
+		OP_ALU_R(0xB4,OR,H)  OP_ALU_R(0xB5,OR,L)  OP_ALU_HL(0xB6,OR)  OP_ALU_R(0xB7,OR,A)
+		OP_ALU_R(0xB8,CP,B)  OP_ALU_R(0xB9,CP,C)  OP_ALU_R(0xBA,CP,D)  OP_ALU_R(0xBB,CP,E)
+		OP_ALU_R(0xBC,CP,H)  OP_ALU_R(0xBD,CP,L)  OP_ALU_HL(0xBE,CP)  OP_ALU_R(0xBF,CP,A)
+
+		OP_ALU_IMM8(0xC6,ADD) OP_ALU_IMM8(0xCE,ADC) OP_ALU_IMM8(0xD6,SUB) OP_ALU_IMM8(0xDE,SBC)
+		OP_ALU_IMM8(0xE6,AND) OP_ALU_IMM8(0xEE,XOR) OP_ALU_IMM8(0xF6,OR)  OP_ALU_IMM8(0xFE,CP)
+
+		OP_INC_R(0x04,B) OP_INC_R(0x0C,C) OP_INC_R(0x14,D) OP_INC_R(0x1C,E)
+		OP_INC_R(0x24,H) OP_INC_R(0x2C,L) OP_INC_R(0x3C,A)
+		OP_DEC_R(0x05,B) OP_DEC_R(0x0D,C) OP_DEC_R(0x15,D) OP_DEC_R(0x1D,E)
+		OP_DEC_R(0x25,H) OP_DEC_R(0x2D,L) OP_DEC_R(0x3D,A)
+		OPCODE(0x34) { // inc [hl]
+			uint8_t data = READ(REG_HL());
+			ALU_INC(data);
+			WRITE(REG_HL(),data);
+			PC += 1; TICK(3); NEXT();
+		}
+		OPCODE(0x35) { // dec [hl]
+			uint8_t data = READ(REG_HL());
+			ALU_DEC(data);
+			WRITE(REG_HL(),data);
+			PC += 1; TICK(3); NEXT();
+		}
+
+		OPCODE(0x03) { SET_BC(REG_BC() + 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x13) { SET_DE(REG_DE() + 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x23) { SET_HL(REG_HL() + 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x33) { SP += 1; PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x0B) { SET_BC(REG_BC() - 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x1B) { SET_DE(REG_DE() - 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x2B) { SET_HL(REG_HL() - 1); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x3B) { SP -= 1; PC += 1; TICK(2); NEXT(); }
+
+		OPCODE(0x09) { ALU_ADDHL(REG_BC()); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x19) { ALU_ADDHL(REG_DE()); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x29) { ALU_ADDHL(REG_HL()); PC += 1; TICK(2); NEXT(); }
+		OPCODE(0x39) { ALU_ADDHL(SP); PC += 1; TICK(2); NEXT(); }
+
+		// rotates & flags ----------------------------------@/
+		OPCODE(0x07) { // rlca
+			int hibit = A >> 7;
+			A = (A<<1) | hibit;
+			FLAGS_SET(0,0,0,hibit);
+			PC += 1; TICK(1); NEXT();
+		}
+		OPCODE(0x17) { // rla
+			int hibit = A >> 7;
+			A = (A<<1) | FLAG_C();
+			FLAGS_SET(0,0,0,hibit);
+			PC += 1; TICK(1); NEXT();
+		}
+		OPCODE(0x0F) { // rrca
+			int lobit = A & 1;
+			A = (A>>1) | (lobit<<7);
+			FLAGS_SET(0,0,0,lobit);
+			PC += 1; TICK(1); NEXT();
+		}
+		OPCODE(0x1F) { // rra
+			int lobit = A & 1;
+			A = (A>>1) | (FLAG_C()<<7);
+			FLAGS_SET(0,0,0,lobit);
+			PC += 1; TICK(1); NEXT();
+		}
+		OPCODE(0x2F) { A = ~A; F |= 0x60; PC += 1; TICK(1); NEXT(); } // cpl
+		OPCODE(0x37) { F = (F & 0x80) | 0x10; PC += 1; TICK(1); NEXT(); } // scf
+		OPCODE(0x3F) { F = (F & 0x80) | (~F & 0x10); PC += 1; TICK(1); NEXT(); } // ccf
+
+		// jumps & calls ------------------------------------@/
+		OP_JR_COND(0x18,true)
+		OP_JR_COND(0x20,!FLAG_Z()) OP_JR_COND(0x28,FLAG_Z())
+		OP_JR_COND(0x30,!FLAG_C()) OP_JR_COND(0x38,FLAG_C())
+		OP_JP_COND(0xC2,!FLAG_Z()) OP_JP_COND(0xCA,FLAG_Z())
+		OP_JP_COND(0xD2,!FLAG_C()) OP_JP_COND(0xDA,FLAG_C())
+		OPCODE(0xC3) { PC = READ_PC16(1); TICK(4); NEXT(); }
+		OPCODE(0xE9) { PC = REG_HL(); TICK(1); NEXT(); }
+
+		OP_CALL_COND(0xCD,true)
+		OP_CALL_COND(0xC4,!FLAG_Z()) OP_CALL_COND(0xCC,FLAG_Z())
+		OP_CALL_COND(0xD4,!FLAG_C()) OP_CALL_COND(0xDC,FLAG_C())
+
+		OPCODE(0xC9) { POP16(PC); profile_return(SP); TICK(4); NEXT(); }
+		OPCODE(0xD9) { POP16(PC); profile_return(SP); m_should_enableIME = true; clock_reschedule(); TICK(4); NEXT(); }
+		OP_RET_COND(0xC0,!FLAG_Z()) OP_RET_COND(0xC8,FLAG_Z())
+		OP_RET_COND(0xD0,!FLAG_C()) OP_RET_COND(0xD8,FLAG_C())
+
+		OP_RST(0xC7,0x00) OP_RST(0xCF,0x08) OP_RST(0xD7,0x10) OP_RST(0xDF,0x18)
+		OP_RST(0xE7,0x20) OP_RST(0xEF,0x28) OP_RST(0xF7,0x30) OP_RST(0xFF,0x38)
+
+		// stack --------------------------------------------@/
+		OP_PUSH(0xC5,REG_BC()) OP_PUSH(0xD5,REG_DE()) OP_PUSH(0xE5,REG_HL())
+		OP_PUSH(0xF5,(A<<8) | F)
+		OP_POP(0xC1,SET_BC) OP_POP(0xD1,SET_DE) OP_POP(0xE1,SET_HL)
+		OPCODE(0xF1) {
+			F = READ(SP) & 0xF0;
+			A = READ(SP+1);
+			SP += 2;
+			PC += 1; TICK(3); NEXT();
+		}
+
+		// misc ---------------------------------------------@/
+		OPCODE(0x00) { PC += 1; TICK(1); NEXT(); }
+		OPCODE(0xF3) { m_regIME = false; PC += 1; TICK(1); NEXT(); }
+		OPCODE(0xFB) { m_should_enableIME = true; clock_reschedule(); PC += 1; TICK(1); NEXT(); }
+		OPCODE(0x76) { // halt
+			PC += 1;
+			halt_waitStart();
+			m_PC = PC; m_SP = SP;
+			halt_run();
+			PC = m_PC; SP = m_SP;
+			NEXT();
+		}
+
+		// table fallbacks ----------------------------------@/
+		OP_FALLBACK(0x10) // stop
+		OP_FALLBACK(0x27) // daa
+		OP_FALLBACK(0xCB) // prefix
+		OP_FALLBACK(0xE8) // add sp,imm8
+		OP_FALLBACK(0xF8) // ld hl,sp+imm8
+		OP_FALLBACK(0xD3) OP_FALLBACK(0xDB) OP_FALLBACK(0xDD) OP_FALLBACK(0xE3)
+		OP_FALLBACK(0xE4) OP_FALLBACK(0xEB) OP_FALLBACK(0xEC) OP_FALLBACK(0xED)
+		OP_FALLBACK(0xF4) OP_FALLBACK(0xFC) OP_FALLBACK(0xFD)
+
+#ifndef FERN_COMPUTED_GOTO
+		}
+		}
+#endif
+	slice_end:
+		SYNC_STORE();
+	}
+}
+
+#endif
@@ -1,30 +1,85 @@
 #include <fern.h>
 #include <vector>
 #include <iostream>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 
 #include <SDL2/SDL.h>
 
+namespace {
+	// reads "[bank:]start[-end]" in hex. without a bank it's any bank.
+	auto debug_readRange(int& bank,int& start,int& end) -> bool {
+		std::string text;
+		std::cin >> text;
+		bank = -1;
+		const auto colon = text.find(':');
+		if(colon != std::string::npos) {
+			if(std::sscanf(text.c_str(),"%x",&bank) != 1) return false;
+			text = text.substr(colon + 1);
+		}
+		const int count = std::sscanf(text.c_str(),"%x-%x",&start,&end);
+		if(count == 1) end = start;
+		return count >= 1 && start <= end && end <= 0xFFFF;
+	}
+	auto debug_readAddress(int& bank,int& addr) -> bool {
+		int end = 0;
+		return debug_readRange(bank,addr,end) && end == addr;
+	}
+	auto debug_bankName(int bank) -> std::string {
+		if(bank < 0) return "**";
+		char name[12];
+		std::snprintf(name,sizeof(name),"%02X",bank);
+		return name;
+	}
+	auto debug_printBreakpoint(int index,const fern::CBreakpoint& bp) -> void {
+		std::printf("breakpoint %d: %s:%04X",index,debug_bankName(bp.bank).c_str(),bp.addr);
+		std::printf(" (hit %u times",bp.hits);
+		if(bp.ignore > 0) std::printf(", stops after %u",bp.ignore);
+		std::puts(")");
+	}
+	auto debug_watchKindName(int kind) -> std::string {
+		std::string name;
+		if(kind & fern::WatchKind::read) name += "r";
+		if(kind & fern::WatchKind::write) name += "w";
+		if(kind & fern::WatchKind::change) name += "c";
+		return name;
+	}
+	auto debug_printWatchpoint(int index,const fern::CWatchpoint& wp) -> void {
+		std::printf("watchpoint %d: %s:%04X",index,debug_bankName(wp.bank).c_str(),wp.start);
+		if(wp.end != wp.start) std::printf("-%04X",wp.end);
+		std::printf(" (%s)\n",debug_watchKindName(wp.kind).c_str());
+	}
+}
+
 namespace fern {
 	CEmulator::CEmulator(const CEmuInitFlags* flags) {
 		CEmuInitFlags default_flags;
 		if(!flags) flags = &default_flags;
 
 		m_quitflag = false;
-		m_cgbEnabled = true;
 
 		m_nowaitEnable = false;
 		m_debugEnable = flags->debug;
-		m_debugSkipping = false;
-		m_debugSkipAddr = 0;
 		m_verboseEnable = flags->verbose;
+		if(flags->profile) cpu.profile_enable(true);
+		m_symfilename = flags->symfile;
+		m_tracefilename = flags->tracefile;
+		m_gdbPort = flags->gdbport;
 
 		m_savetimer = 0;
 
 		m_romfilename = {};
 
+		m_inputClock = 0;
+		m_inputHeld = 0;
+		m_joypad = 0;
+		m_frameReady = false;
+
 		cpu.assign_emu(this);
 		mem.assign_emu(this);
 		renderer.assign_emu(this);
+		gdb.assign_emu(this);
 
 		if( SDL_Init( SDL_INIT_VIDEO ) < 0 )
 		{
@@ -53,8 +108,23 @@ namespace fern {
 		}
 		return m_romfilename + ".fsv";
 	}
+	// RGBDS writes game.sym next to game.gb
+	auto CEmulator::symbols_getFilename() -> std::optional<std::string> {
+		if(!m_symfilename.empty()) {
+			return m_symfilename;
+		}
+		if(m_romfilename.empty()) {
+			return {};
+		}
+		const auto dot = m_romfilename.find_last_of('.');
+		const auto slash = m_romfilename.find_last_of("/\\");
+		if(dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+			return m_romfilename + ".sym";
+		}
+		return m_romfilename.substr(0,dot) + ".sym";
+	}
 	auto CEmulator::savedata_sync() -> void {
-		auto savedat = mem.m_mapper->sram_serialize();
+		auto savedat = mem.mapper_sramSerialize();
 		if(savedat.size() == 0) return;
 		
 		Blob blob_header;
@@ -74,6 +144,8 @@ namespace fern {
 		}
 	}
 
+	// UI thread: handles window events, and turns keyboard changes into
+	// input events for the emulation thread.
 	auto CEmulator::process_message() -> void {
 		SDL_Event eve;
 		while(SDL_PollEvent(&eve)) {
@@ -104,42 +176,114 @@ namespace fern {
 		
 		// get keyboard state
 		const auto keystate = SDL_GetKeyboardState(NULL);
-		m_joypad_state.at(EmuButton::up) = keystate[SDL_SCANCODE_UP];
-		m_joypad_state.at(EmuButton::down) = keystate[SDL_SCANCODE_DOWN];
-		m_joypad_state.at(EmuButton::left) = keystate[SDL_SCANCODE_LEFT];
-		m_joypad_state.at(EmuButton::right) = keystate[SDL_SCANCODE_RIGHT];
-		m_joypad_state.at(EmuButton::b) = keystate[SDL_SCANCODE_A];
-		m_joypad_state.at(EmuButton::a) = keystate[SDL_SCANCODE_S];
-		m_joypad_state.at(EmuButton::start) = keystate[SDL_SCANCODE_B];
-		m_joypad_state.at(EmuButton::select) = keystate[SDL_SCANCODE_V];
-
-		// deal with saving
-		if(SDL_GetTicks() - m_savetimer >= fern::CEmulator::SAVE_DURATION) {
-			m_savetimer = SDL_GetTicks();
-			savedata_sync();
+		const std::array<int,EmuButton::num_keys> keymap = {
+			SDL_SCANCODE_RIGHT,SDL_SCANCODE_LEFT,SDL_SCANCODE_UP,SDL_SCANCODE_DOWN,
+			SDL_SCANCODE_S,SDL_SCANCODE_A,SDL_SCANCODE_V,SDL_SCANCODE_B
+		};
+		for(int btn=0; btn<EmuButton::num_keys; btn++) {
+			const bool held = keystate[keymap[btn]];
+			if(held != ((m_inputHeld >> btn) & 1)) {
+				input_push(btn,held);
+			}
+		}
+	}
+	// UI thread. the event's stamped with the clock at the last frame, so
+	// it's applied at the start of the next one.
+	auto CEmulator::input_push(int btn,bool pressed) -> void {
+		const CInputEvent event = {
+			m_inputClock.load(std::memory_order_relaxed),
+			static_cast<uint8_t>(btn),
+			pressed
+		};
+		// if it's full, the change is picked up on a later poll
+		if(!m_inputQueue.push(event)) return;
+		m_inputHeld ^= 1<<btn;
+	}
+	// emulation thread: applies every event that's due by now.
+	auto CEmulator::input_apply() -> void {
+		CInputEvent event;
+		while(m_inputQueue.front(event) && event.time <= cpu.clock_cycles()) {
+			m_inputQueue.pop();
+			if(event.pressed) {
+				m_joypad |= 1<<event.button;
+			} else {
+				m_joypad &= ~(1<<event.button);
+			}
 		}
 	}
 	auto CEmulator::button_held(int btn) -> bool {
 		if(btn < 0) return false;
 		if(btn >= EmuButton::num_keys) return false;
-		return m_joypad_state.at(btn);
+		return (m_joypad >> btn) & 1;
 	}
 
-	auto CEmulator::boot() -> void {
-		std::puts("booting rom...");
-		std::printf("mapper: %s\n",mem.m_mapper->name().c_str());
+	// emulation thread: waits for the UI thread to take the frame.
+	auto CEmulator::frame_publish() -> void {
+		m_inputClock.store(cpu.clock_cycles(),std::memory_order_relaxed);
+		std::unique_lock<std::mutex> lock(m_frameMutex);
+		m_frameReady = true;
+		m_frameCond.notify_all();
+		m_frameCond.wait(lock,[&]() { return !m_frameReady || did_quit(); });
+	}
+	// UI thread: presents a finished frame, if there is one. the emulation
+	// thread carries on with the next while this waits to flip.
+	auto CEmulator::frame_present() -> void {
+		{
+			std::unique_lock<std::mutex> lock(m_frameMutex);
+			const auto poll_time = std::chrono::milliseconds(1);
+			if(!m_frameCond.wait_for(lock,poll_time,[&]() { return m_frameReady; })) {
+				return;
+			}
+			renderer.present();
+			m_frameReady = false;
+			m_frameCond.notify_all();
+		}
+		renderer.flip();
+	}
+
+	// runs up to the start of the next vblank. with the LCD off there isn't
+	// one, so it stops after a frame's worth of cycles instead.
+	auto CEmulator::run_frame() -> void {
+		const uint64_t frame_cycles = cpu.speed_doubled() ? FRAME_CYCLES*2 : FRAME_CYCLES;
+		cpu.run_until(cpu.clock_cycles() + frame_cycles,true);
+	}
+	auto CEmulator::run_cycles(uint64_t cycles) -> void {
+		cpu.run_until(cpu.clock_cycles() + cycles,false);
+	}
+
+	// says which breakpoint or watchpoint stopped the CPU, if one did.
+	auto CEmulator::debug_reportStop() -> bool {
+		if(!cpu.break_stopped()) return false;
+		cpu.break_clearStop();
+		if(mem.watch_fired()) {
+			mem.watch_clearFired();
+			const auto& hit = mem.watch_hit();
+			std::printf("watchpoint (%s) at %02X:%04X: $%02X -> $%02X",
+				debug_watchKindName(hit.kind).c_str(),hit.bank,hit.addr,hit.old_value,hit.new_value
+			);
+			if(hit.pc >= 0) std::printf(", by the instruction at $%04X",hit.pc);
+			std::puts("");
+		} else {
+			const auto& bp = cpu.break_last();
+			std::printf("stopped at %02X:%04X\n",bp.bank,bp.addr);
+		}
+		return true;
+	}
 
+	// the main thread's left for SDL (see boot()). this runs everything
+	// else, and never touches SDL for input.
+	auto CEmulator::emu_thread() -> void {
 		cpu.step();
 
 		while(!did_quit()) {
-			if(m_debugSkipping) {
-				if(cpu.m_PC == m_debugSkipAddr) {
-					debug_set(true);
-					m_debugSkipping = false;
-				}
+			input_apply();
+
+			// gdb has the CPU until it continues
+			if(gdb.stopped()) {
+				gdb.serve();
 			}
 			// debug process
-			if(m_debugEnable) {
+			else if(m_debugEnable) {
 				std::string cmdname;
 				std::printf("enter command (type h for help): ");
 				std::cin >> cmdname;
@@ -151,6 +295,12 @@ namespace fern {
 						"\t[s]tep   - step 1 instruction\n"
 						"\t[ss]tep  - step multiple instructions\n"
 						"\t[g]o     - run intil specified address\n"
+						"\t[b]reak  - add a breakpoint ([bank:]address)\n"
+						"\t[bl]ist  - list breakpoints\n"
+						"\t[bd]el   - delete a breakpoint\n"
+						"\t[wa]tch  - add a watchpoint ([bank:]start[-end])\n"
+						"\t[wl]ist  - list watchpoints\n"
+						"\t[wd]el   - delete a watchpoint\n"
 						"\t[p]eek   - peek (aka. read) specified address\n"
 						"\t[q]uit   - stop emulation"
 					);
@@ -159,7 +309,7 @@ namespace fern {
 					int peek_addr = 0;
 					std::printf("where to? (hex): ");
 					std::scanf("%x",&peek_addr);
-					std::printf("read $%04X: $%04X\n",peek_addr,mem.read(peek_addr));
+					std::printf("read $%04X: $%04X\n",peek_addr,mem.peek(peek_addr));
 				}
 				else if(cmdname == "q") {
 					quit();
@@ -176,17 +326,86 @@ namespace fern {
 						std::printf("how many lines? (int): ");
 						std::scanf("%d",&to_step);
 					}
-					for(int i=0; i<to_step; i++) cpu.step();
+					for(int i=0; i<to_step; i++) {
+						cpu.step();
+						if(debug_reportStop()) break;
+					}
 
 					cpu.print_status(true);
 				}
 				else if(cmdname == "g") {
+					int bank = -1;
 					int to_addr = 0;
-					std::printf("where to? (hex): ");
-					std::scanf("%x",&to_addr);
-					m_debugSkipAddr = to_addr;
-					m_debugSkipping = true;
-					debug_set(false);
+					std::printf("where to? ([bank:]hex): ");
+					if(debug_readAddress(bank,to_addr)) {
+						cpu.break_add(bank,to_addr,0,true);
+						debug_set(false);
+					} else {
+						std::puts("bad address");
+					}
+				}
+				else if(cmdname == "b") {
+					int bank = -1;
+					int addr = 0;
+					int ignore = 0;
+					std::printf("where? ([bank:]hex): ");
+					if(debug_readAddress(bank,addr)) {
+						std::printf("hits to skip? (int): ");
+						std::scanf("%d",&ignore);
+						const int index = cpu.break_add(bank,addr,std::max(ignore,0),false);
+						debug_printBreakpoint(index,cpu.break_list()[index]);
+					} else {
+						std::puts("bad address");
+					}
+				}
+				else if(cmdname == "bl") {
+					const auto& list = cpu.break_list();
+					if(list.empty()) std::puts("no breakpoints");
+					for(size_t i=0; i<list.size(); i++) {
+						debug_printBreakpoint(i,list[i]);
+					}
+				}
+				else if(cmdname == "bd") {
+					int index = 0;
+					std::printf("which one? (int): ");
+					std::scanf("%d",&index);
+					if(!cpu.break_remove(index)) {
+						std::printf("no breakpoint %d\n",index);
+					}
+				}
+				else if(cmdname == "wa") {
+					int bank = -1;
+					int start = 0;
+					int end = 0;
+					std::string kinds;
+					std::printf("on what? ([r]ead/[w]rite/[c]hange, any of): ");
+					std::cin >> kinds;
+					int kind = 0;
+					if(kinds.find('r') != std::string::npos) kind |= WatchKind::read;
+					if(kinds.find('w') != std::string::npos) kind |= WatchKind::write;
+					if(kinds.find('c') != std::string::npos) kind |= WatchKind::change;
+					std::printf("where? ([bank:]hex[-hex]): ");
+					if(kind != 0 && debug_readRange(bank,start,end)) {
+						const int index = mem.watch_add(bank,start,end,kind);
+						debug_printWatchpoint(index,mem.watch_list()[index]);
+					} else {
+						std::puts("bad watchpoint");
+					}
+				}
+				else if(cmdname == "wl") {
+					const auto& list = mem.watch_list();
+					if(list.empty()) std::puts("no watchpoints");
+					for(size_t i=0; i<list.size(); i++) {
+						debug_printWatchpoint(i,list[i]);
+					}
+				}
+				else if(cmdname == "wd") {
+					int index = 0;
+					std::printf("which one? (int): ");
+					std::scanf("%d",&index);
+					if(!mem.watch_remove(index)) {
+						std::printf("no watchpoint %d\n",index);
+					}
 				}
 				else {
 					std::printf("unknown command %s\n",cmdname.c_str());
@@ -194,11 +413,74 @@ namespace fern {
 			} 
 			// regular process
 			else {
-				cpu.step();
+				run_frame();
+				if(gdb.connected() && cpu.break_stopped()) {
+					gdb.stop();
+				} else if(debug_reportStop()) {
+					debug_set(true);
+					cpu.print_status(true);
+				} else {
+					// shown even with the LCD off, so the pacing stays the same
+					cpu.m_frameDone = true;
+				}
+				gdb.poll();
+			}
+			if(cpu.m_frameDone) {
+				cpu.m_frameDone = false;
+				frame_publish();
+			}
+
+			// deal with saving
+			if(SDL_GetTicks() - m_savetimer >= fern::CEmulator::SAVE_DURATION) {
+				m_savetimer = SDL_GetTicks();
+				savedata_sync();
 			}
-			process_message();
 		}
+	}
 
+	auto CEmulator::boot() -> void {
+		std::puts("booting rom...");
+		std::printf("mapper: %s\n",mem.mapper_name().c_str());
+		if(cpu.profile_enabled()) {
+			auto sym_name = symbols_getFilename();
+			if(sym_name && !cpu.profile_loadSymbols(sym_name.value()) && !m_symfilename.empty()) {
+				std::printf("warning: couldn't load symbols from '%s'\n",sym_name.value().c_str());
+			}
+		}
+		if(!m_tracefilename.empty()) {
+			cpu.trace_start(m_tracefilename);
+		}
+		if(m_gdbPort > 0 && !gdb.listen(m_gdbPort)) {
+			std::printf("error: couldn't listen for gdb on port %d\n",m_gdbPort);
+			std::exit(-1);
+		}
+
+		std::thread emulation(&CEmulator::emu_thread,this);
+		while(!did_quit()) {
+			process_message();
+			frame_present();
+		}
+		// let the emulation thread go, if it's waiting on a frame
+		{
+			std::unique_lock<std::mutex> lock(m_frameMutex);
+			m_frameCond.notify_all();
+		}
+		emulation.join();
+		cpu.trace_stop();
+		gdb.close();
+
+#ifndef FERN_NO_IDLESKIP
+		if(verbose_enabled()) {
+			std::printf("idle loops skipped: %llu (%llu cycles)\n",
+				static_cast<unsigned long long>(cpu.m_idleSkips),
+				static_cast<unsigned long long>(cpu.m_idleSkippedCycles)
+			);
+		}
+#endif
+		if(cpu.profile_enabled()) {
+			cpu.profile_report();
+			cpu.profile_writeCollapsed(m_romfilename + ".folded");
+		}
 		savedata_sync();
 	}
 	auto CEmulator::load_romfile(const std::string& filename) -> void {
@@ -246,17 +528,19 @@ namespace fern {
 
 		// setup cgb flags ------------------------------@/
 		int cgb_flag = rom_vec.at(0x143);
+		bool cgb = false;
 		if( (cgb_flag == 0x80) || (cgb_flag == 0xC0) ) {
-			m_cgbEnabled = true;
+			cgb = true;
 			std::puts("CGB mode!");
 		} else if(cgb_flag == 0x00) {
-			m_cgbEnabled = false;
+			cgb = false;
 		} else {
 			std::printf("warning: ROM has unknown CGB flag. ($%02X) emulation may not work properly...\n",
 				cgb_flag
 			);
-			m_cgbEnabled = false;
+			cgb = false;
 		}
+		mem.model_set(cgb);
 
 		// setup banks ----------------------------------@/
 		if(sram_used) {
@@ -335,6 +619,7 @@ namespace fern {
 		if(cgb_enabled()) {
 			cpu.m_regA = 0x11;
 		}
+		mem.pages_mapAll();
 	}
 }
 
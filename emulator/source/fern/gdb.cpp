@@ -0,0 +1,444 @@
+// winsock2 has to come before anything that pulls in windows.h
+#ifdef FERN_GDB
+	#ifdef _WIN32
+		#include <winsock2.h>
+		#include <ws2tcpip.h>
+	#else
+		#include <sys/socket.h>
+		#include <sys/select.h>
+		#include <netinet/in.h>
+		#include <netinet/tcp.h>
+		#include <arpa/inet.h>
+		#include <unistd.h>
+	#endif
+#endif
+#include <fern.h>
+#include <fern_common.h>
+
+// GDB remote stub ----------------------------------------------------------@/
+// speaks enough of gdb's remote serial protocol for registers, memory
+// (through CMem, so it's the bus the CPU sees), step, continue, and
+// breakpoints & watchpoints (Z0-Z4, on CCPU's and CMem's). only one gdb
+// at a time, on 127.0.0.1. addresses are 16 bit, so breakpoints are for
+// any bank.
+// connect with `target remote localhost:<port>`.
+#ifdef FERN_GDB
+
+namespace {
+#ifdef _WIN32
+	using socket_t = SOCKET;
+	auto socket_close(intptr_t sock) -> void { closesocket(static_cast<socket_t>(sock)); }
+#else
+	using socket_t = int;
+	auto socket_close(intptr_t sock) -> void { ::close(static_cast<socket_t>(sock)); }
+#endif
+	// true if sock has something to read (or accept) within timeout_ms.
+	auto socket_wait(intptr_t sock,int timeout_ms) -> bool {
+		fd_set set;
+		FD_ZERO(&set);
+		FD_SET(static_cast<socket_t>(sock),&set);
+		timeval timeout = { timeout_ms / 1000,(timeout_ms % 1000) * 1000 };
+		return select(static_cast<int>(sock) + 1,&set,nullptr,nullptr,&timeout) > 0;
+	}
+
+	auto hex_digit(char c) -> int {
+		if(c >= '0' && c <= '9') return c - '0';
+		if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+	// reads hex digits from text at pos, up to the first non-hex one.
+	auto hex_read(const std::string& text,size_t& pos) -> int {
+		int value = 0;
+		while(pos < text.size() && hex_digit(text[pos]) >= 0) {
+			value = (value<<4) | hex_digit(text[pos]);
+			pos += 1;
+		}
+		return value;
+	}
+	// the byte in the two hex digits at pos, and a little endian word.
+	auto hex_byteAt(const std::string& text,size_t pos) -> int {
+		if(pos + 2 > text.size()) return 0;
+		const int hi = hex_digit(text[pos]);
+		const int lo = hex_digit(text[pos + 1]);
+		return (hi < 0 || lo < 0) ? 0 : ((hi<<4) | lo);
+	}
+	auto hex_wordAt(const std::string& text,size_t pos) -> int {
+		return hex_byteAt(text,pos) | (hex_byteAt(text,pos + 2)<<8);
+	}
+	auto hex_byte(int value) -> std::string {
+		char text[3];
+		std::snprintf(text,sizeof(text),"%02x",value & 0xFF);
+		return text;
+	}
+	// registers go little endian
+	auto hex_word(int value) -> std::string {
+		return hex_byte(value) + hex_byte(value>>8);
+	}
+}
+
+namespace fern {
+	CGdbStub::CGdbStub() {
+		m_listenSocket = -1;
+		m_socket = -1;
+		m_stopped = false;
+	}
+	CGdbStub::~CGdbStub() {
+		close();
+	}
+
+	auto CGdbStub::listen(int port) -> bool {
+		close();
+#ifdef _WIN32
+		WSADATA wsa_data;
+		if(WSAStartup(MAKEWORD(2,2),&wsa_data) != 0) return false;
+#endif
+		const socket_t sock = socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
+		if(sock == static_cast<socket_t>(-1)) return false;
+
+		const int reuse = 1;
+		setsockopt(sock,SOL_SOCKET,SO_REUSEADDR,reinterpret_cast<const char*>(&reuse),sizeof(reuse));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(port);
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if(bind(sock,reinterpret_cast<sockaddr*>(&addr),sizeof(addr)) != 0 || ::listen(sock,1) != 0) {
+			socket_close(sock);
+			return false;
+		}
+		m_listenSocket = sock;
+		std::printf("gdb: listening on localhost:%d\n",port);
+		return true;
+	}
+	auto CGdbStub::close() -> void {
+		disconnect();
+		if(m_listenSocket != -1) {
+			socket_close(m_listenSocket);
+			m_listenSocket = -1;
+		}
+	}
+	auto CGdbStub::disconnect() -> void {
+		if(m_socket != -1) {
+			socket_close(m_socket);
+			m_socket = -1;
+			std::puts("gdb: disconnected");
+		}
+		m_input.clear();
+		m_stopped = false;
+	}
+
+	// emulation thread, between frames. picks up new connections (which
+	// stop the CPU, like gdb expects), and ^C.
+	auto CGdbStub::poll() -> void {
+		if(m_listenSocket == -1) return;
+		if(!connected()) {
+			if(!socket_wait(m_listenSocket,0)) return;
+			const socket_t sock = accept(static_cast<socket_t>(m_listenSocket),nullptr,nullptr);
+			if(sock == static_cast<socket_t>(-1)) return;
+			const int nodelay = 1;
+			setsockopt(sock,IPPROTO_TCP,TCP_NODELAY,reinterpret_cast<const char*>(&nodelay),sizeof(nodelay));
+			m_socket = sock;
+			m_stopped = true;
+			m_stopReply = "S05";
+			std::puts("gdb: connected");
+			return;
+		}
+		if(!socket_wait(m_socket,0)) return;
+		if(!receive()) return;
+		const auto interrupt = m_input.find('\x03');
+		if(interrupt != std::string::npos) {
+			m_input.erase(0,interrupt + 1);
+			m_stopped = true;
+			m_stopReply = "S02";
+			packet_send(m_stopReply);
+		}
+	}
+	// the CPU's stopped at a breakpoint or watchpoint: tells gdb, which
+	// takes over until it continues.
+	auto CGdbStub::stop() -> void {
+		m_stopped = true;
+		m_stopReply = stop_reply();
+		emu()->cpu.break_clearStop();
+		emu()->mem.watch_clearFired();
+		packet_send(m_stopReply);
+	}
+	// handles gdb's packets until it continues (or goes away). polls so
+	// the window can still be closed.
+	auto CGdbStub::serve() -> void {
+		while(m_stopped && connected() && !emu()->did_quit()) {
+			if(!socket_wait(m_socket,50)) continue;
+			if(!receive()) return;
+			std::string packet;
+			while(m_stopped && packet_next(packet)) {
+				packet_handle(packet);
+			}
+		}
+	}
+
+	// packets ------------------------------------------@/
+	auto CGdbStub::receive() -> bool {
+		char buffer[1024];
+		const int count = recv(static_cast<socket_t>(m_socket),buffer,sizeof(buffer),0);
+		if(count <= 0) {
+			disconnect();
+			return false;
+		}
+		m_input.append(buffer,count);
+		return true;
+	}
+	// takes the next whole packet out of m_input, and acks it.
+	auto CGdbStub::packet_next(std::string& packet) -> bool {
+		while(true) {
+			const auto start = m_input.find('$');
+			if(start == std::string::npos) {
+				// acks & stray ^Cs
+				m_input.clear();
+				return false;
+			}
+			const auto end = m_input.find('#',start);
+			if(end == std::string::npos || end + 2 >= m_input.size()) {
+				m_input.erase(0,start);
+				return false;
+			}
+			packet = m_input.substr(start + 1,end - start - 1);
+			const int sum = hex_byteAt(m_input,end + 1);
+			m_input.erase(0,end + 3);
+
+			int check = 0;
+			for(char c : packet) check += static_cast<uint8_t>(c);
+			const bool ok = (check & 0xFF) == sum;
+			send(static_cast<socket_t>(m_socket),ok ? "+" : "-",1,0);
+			if(ok) return true;
+		}
+	}
+	auto CGdbStub::packet_send(const std::string& data) -> void {
+		if(!connected()) return;
+		int check = 0;
+		for(char c : data) check += static_cast<uint8_t>(c);
+		const std::string packet = "$" + data + "#" + hex_byte(check);
+		send(static_cast<socket_t>(m_socket),packet.data(),packet.size(),0);
+	}
+
+	auto CGdbStub::packet_handle(const std::string& packet) -> void {
+		auto& cpu = emu()->cpu;
+		auto& mem = emu()->mem;
+		size_t pos = 1;
+		switch(packet[0]) {
+			case '?': {
+				packet_send(m_stopReply);
+				break;
+			}
+			// registers --------------------------------@/
+			case 'g': {
+				std::string reply;
+				for(int i=0; i<REGISTER_COUNT; i++) reply += hex_word(register_get(i));
+				packet_send(reply);
+				break;
+			}
+			case 'G': {
+				for(int i=0; i<REGISTER_COUNT && pos + 4 <= packet.size(); i++) {
+					register_set(i,hex_wordAt(packet,pos));
+					pos += 4;
+				}
+				packet_send("OK");
+				break;
+			}
+			case 'p': {
+				const int index = hex_read(packet,pos);
+				packet_send(index < REGISTER_COUNT ? hex_word(register_get(index)) : "E00");
+				break;
+			}
+			case 'P': {
+				const int index = hex_read(packet,pos);
+				pos += 1; // '='
+				if(index >= REGISTER_COUNT) {
+					packet_send("E00");
+					break;
+				}
+				register_set(index,hex_wordAt(packet,pos));
+				packet_send("OK");
+				break;
+			}
+			// memory -----------------------------------@/
+			case 'm': {
+				const int addr = hex_read(packet,pos);
+				pos += 1; // ','
+				const int length = std::min(hex_read(packet,pos),0x800);
+				std::string reply;
+				for(int i=0; i<length; i++) reply += hex_byte(mem.peek((addr + i) & 0xFFFF));
+				packet_send(reply);
+				break;
+			}
+			case 'M': {
+				const int addr = hex_read(packet,pos);
+				pos += 1; // ','
+				const int length = hex_read(packet,pos);
+				pos += 1; // ':'
+				for(int i=0; i<length && pos + 2 <= packet.size(); i++) {
+					mem.write((addr + i) & 0xFFFF,hex_byteAt(packet,pos));
+					pos += 2;
+				}
+				// writes to watched memory don't count
+				cpu.break_clearStop();
+				mem.watch_clearFired();
+				packet_send("OK");
+				break;
+			}
+			// running ----------------------------------@/
+			case 'c': {
+				if(pos < packet.size()) cpu.pc_set(hex_read(packet,pos));
+				cpu.break_clearStop();
+				mem.watch_clearFired();
+				m_stopped = false;
+				break;
+			}
+			case 's': {
+				if(pos < packet.size()) cpu.pc_set(hex_read(packet,pos));
+				cpu.break_clearStop();
+				mem.watch_clearFired();
+				cpu.step();
+				m_stopReply = stop_reply();
+				cpu.break_clearStop();
+				mem.watch_clearFired();
+				packet_send(m_stopReply);
+				break;
+			}
+			case 'Z':
+			case 'z': {
+				packet_send(point_set(packet,packet[0] == 'Z') ? "OK" : "");
+				break;
+			}
+			case 'k': {
+				disconnect();
+				emu()->quit();
+				break;
+			}
+			case 'D': {
+				packet_send("OK");
+				disconnect();
+				break;
+			}
+			case 'H': {
+				packet_send("OK");
+				break;
+			}
+			case 'q': {
+				if(packet.rfind("qSupported",0) == 0) {
+					packet_send("PacketSize=1000");
+				} else if(packet == "qAttached") {
+					packet_send("1");
+				} else {
+					packet_send("");
+				}
+				break;
+			}
+			default: {
+				packet_send("");
+				break;
+			}
+		}
+	}
+
+	auto CGdbStub::register_get(int index) -> int {
+		auto& cpu = emu()->cpu;
+		switch(index) {
+			case 0: return cpu.reg_af();
+			case 1: return cpu.reg_bc();
+			case 2: return cpu.reg_de();
+			case 3: return cpu.reg_hl();
+			case 4: return cpu.m_SP;
+			case 5: return cpu.m_PC;
+		}
+		return 0;
+	}
+	auto CGdbStub::register_set(int index,int value) -> void {
+		auto& cpu = emu()->cpu;
+		switch(index) {
+			case 0: {
+				cpu.m_regA = value>>8;
+				cpu.f_set(value & 0xF0);
+				break;
+			}
+			case 1: cpu.bc_set(value); break;
+			case 2: cpu.de_set(value); break;
+			case 3: cpu.hl_set(value); break;
+			case 4: cpu.sp_set(value); break;
+			case 5: cpu.pc_set(value); break;
+		}
+	}
+
+	// S05 (SIGTRAP) for breakpoints & steps, with the address for watchpoints.
+	auto CGdbStub::stop_reply() -> std::string {
+		auto& mem = emu()->mem;
+		if(!mem.watch_fired()) return "S05";
+		const auto& hit = mem.watch_hit();
+		const char* kind = (hit.kind == WatchKind::read) ? "rwatch" : "watch";
+		char reply[32];
+		std::snprintf(reply,sizeof(reply),"T05%s:%04x;",kind,hit.addr);
+		return reply;
+	}
+
+	// Z/z type,addr,length. 0 & 1 are breakpoints, 2-4 are write, read &
+	// access watchpoints. returns false for anything unsupported.
+	auto CGdbStub::point_set(const std::string& packet,bool insert) -> bool {
+		auto& cpu = emu()->cpu;
+		auto& mem = emu()->mem;
+		size_t pos = 1;
+		const int type = hex_read(packet,pos);
+		pos += 1; // ','
+		const int addr = hex_read(packet,pos);
+		pos += 1; // ','
+		const int length = std::max(hex_read(packet,pos),1);
+
+		if(type == 0 || type == 1) {
+			if(insert) {
+				cpu.break_add(-1,addr,0,false);
+				return true;
+			}
+			const auto& list = cpu.break_list();
+			for(size_t i=0; i<list.size(); i++) {
+				if(list[i].bank < 0 && list[i].addr == addr && !list[i].temporary) {
+					return cpu.break_remove(i);
+				}
+			}
+			return true;
+		}
+		if(type >= 2 && type <= 4) {
+			const int kinds[] = { WatchKind::write,WatchKind::read,WatchKind::read | WatchKind::write };
+			const int kind = kinds[type - 2];
+			const int end = std::min(addr + length - 1,0xFFFF);
+			if(insert) {
+				mem.watch_add(-1,addr,end,kind);
+				return true;
+			}
+			const auto& list = mem.watch_list();
+			for(size_t i=0; i<list.size(); i++) {
+				if(list[i].bank < 0 && list[i].start == addr && list[i].end == end && list[i].kind == kind) {
+					return mem.watch_remove(i);
+				}
+			}
+			return true;
+		}
+		return false;
+	}
+}
+
+#else
+namespace fern {
+	CGdbStub::CGdbStub() {
+		m_listenSocket = -1;
+		m_socket = -1;
+		m_stopped = false;
+	}
+	CGdbStub::~CGdbStub() {}
+
+	auto CGdbStub::listen(int port) -> bool {
+		std::puts("warning: the GDB stub isn't built in (build with GDB=1)");
+		return true;
+	}
+	auto CGdbStub::close() -> void {}
+	auto CGdbStub::poll() -> void {}
+	auto CGdbStub::stop() -> void {}
+	auto CGdbStub::serve() -> void {}
+}
+#endif
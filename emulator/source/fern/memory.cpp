@@ -11,13 +11,9 @@ namespace fern {
 	CMem::CMem() {
 		reset();
 	}
-	CMem::~CMem() {
-		delete m_mapper;
-	}
 
 	auto CMem::reset() -> void {
-		delete m_mapper;
-		m_mapper = nullptr;
+		m_mapper.emplace<CMapperNone>();
 		m_io = {};
 		m_io.m_LCDC = 0x91;
 		m_io.m_IF = 0x01;
@@ -29,6 +25,22 @@ namespace fern {
 
 		m_rambankCount = 0;
 		m_rombankCount = 0;
+		m_rombankLatched = 0;
+
+		// everything's slow until the ROM's loaded
+		m_pageRead.fill(nullptr);
+		m_pageWrite.fill(nullptr);
+		m_pageVRAMWritable = false;
+		m_vramDirty = ~uint64_t(0);
+		m_peeking = false;
+		m_watchpoints.clear();
+		m_watchPages.fill(0);
+		m_watchFired = false;
+		m_watchHit = {};
+		model_set(true);
+	}
+	auto CMem::model_set(bool cgb) -> void {
+		m_modelCGB = cgb;
 	}
 
 	auto CMem::palet_getLUT(int palflags) -> std::array<int,4> {
@@ -41,23 +53,29 @@ namespace fern {
 	}
 
 	auto CMem::mapper_setupNone() -> void {
-		m_mapper = new CMapperNone();
-		m_mapper->assign_emu(m_emu);
+		m_mapper.emplace<CMapperNone>().assign_emu(m_emu);
+		rombank_latch();
 	}
 	auto CMem::mapper_setupMBC1(bool use_ram, bool use_battery) -> void {
 		std::printf("created mapper\n");
-		m_mapper = new CMapperMBC1(use_ram, use_battery);
-		m_mapper->assign_emu(m_emu);
+		m_mapper.emplace<CMapperMBC1>(use_ram, use_battery).assign_emu(m_emu);
+		rombank_latch();
 	}
 	auto CMem::mapper_setupMBC3(bool use_ram, bool use_battery, bool use_timer) -> void {
 		std::puts("created mapper");
-		m_mapper = new CMapperMBC3(use_ram, use_battery, use_timer);
-		m_mapper->assign_emu(m_emu);
+		m_mapper.emplace<CMapperMBC3>(use_ram, use_battery, use_timer).assign_emu(m_emu);
+		rombank_latch();
 	}
 	auto CMem::mapper_setupMBC5(bool use_ram, bool use_battery, bool use_rumble) -> void {
 		std::printf("created mapper\n");
-		m_mapper = new CMapperMBC5(use_ram, use_battery, use_rumble);
-		m_mapper->assign_emu(m_emu);
+		m_mapper.emplace<CMapperMBC5>(use_ram, use_battery, use_rumble).assign_emu(m_emu);
+		rombank_latch();
+	}
+	auto CMem::mapper_name() -> std::string {
+		return std::visit([](auto& mapper) { return mapper.name(); },m_mapper);
+	}
+	auto CMem::mapper_sramSerialize() -> Blob {
+		return std::visit([](auto& mapper) { return mapper.sram_serialize(); },m_mapper);
 	}
 
 	auto CMem::interrupt_match(int mask) -> bool {
@@ -67,15 +85,79 @@ namespace fern {
 		m_io.m_IF &= (0xFF ^ mask);
 	}
 	auto CMem::rombank_current() -> int {
-		if(!m_mapper) {
-			std::puts("error: called rombank_current() with invalid mapper");
-			std::exit(-1);
-			return -1;
+		return std::visit([](auto& mapper) { return mapper.rom_bank(); },m_mapper);
+	}
+	// banks past the end of the ROM wrap, like the upper bank bits not being
+	// wired up on the cart. masked here, so everything sees the same bank.
+	auto CMem::rombank_latch() -> void {
+		m_rombankLatched = rombank_current();
+		if(m_rombankCount > 0) m_rombankLatched &= m_rombankCount - 1;
+		pages_mapBanks();
+	}
+
+	// pages --------------------------------------------@/
+	// watched pages stay unmapped for whatever's watched.
+	auto CMem::pages_map(int page,int count,uint8_t* data,bool writable) -> void {
+		for(int i=0; i<count; i++) {
+			uint8_t* page_data = data ? (data + (i<<8)) : nullptr;
+			const int watched = m_watchPages[page + i];
+			m_pageRead[page + i] = (watched & WatchKind::read) ? nullptr : page_data;
+			m_pageWrite[page + i] = (writable && !(watched & (WatchKind::write | WatchKind::change))) ? page_data : nullptr;
 		}
-		return m_mapper->rom_bank();
+	}
+	auto CMem::pages_mapAll() -> void {
+		pages_map(0x00,0x100,nullptr,false);
+		pages_mapBanks();
+		pages_mapVRAM();
+		pages_mapWRAM();
+	}
+	// ROM & SRAM. the mapper can change either on any ROM write.
+	auto CMem::pages_mapBanks() -> void {
+		pages_map(0x00,0x40,m_rombanks[0].data.data(),false);
+		pages_map(0x40,0x40,checked_at(m_rombanks,m_rombankLatched).data.data(),false);
+
+		const int srambank = std::visit([](auto& mapper) { return mapper.sram_bank(); },m_mapper);
+		uint8_t* sram = (srambank >= 0) ? &m_sram[KBSIZE(8) * srambank] : nullptr;
+		pages_map(0xA0,0x20,sram,true);
+	}
+	// VRAM's only written directly while it's accessible (see clock_update()).
+	// with the PPU worker it's never written directly, so write_vram() can
+	// keep track of what the worker's copy is missing.
+	auto CMem::pages_mapVRAM() -> void {
+		m_pageVRAMWritable = vram_accessible();
+#ifdef FERN_PPU_THREAD
+		pages_map(0x80,0x20,&m_vram[KBSIZE(8) * m_io.m_VBK],false);
+#else
+		pages_map(0x80,0x20,&m_vram[KBSIZE(8) * m_io.m_VBK],m_pageVRAMWritable);
+#endif
+	}
+	auto CMem::pages_mapWRAM() -> void {
+		int wrambank = 1;
+		if(m_modelCGB && m_io.m_SVBK != 0) wrambank = m_io.m_SVBK;
+		pages_map(0xC0,0x10,&m_wram[0],true);
+		pages_map(0xD0,0x10,&m_wram[KBSIZE(4) * wrambank],true);
+		// echo RAM, up to OAM
+		pages_map(0xE0,0x10,&m_wram[0],true);
+		pages_map(0xF0,0x0E,&m_wram[KBSIZE(4) * wrambank],true);
 	}
 
-	auto CMem::read(size_t addr) -> uint32_t {
+	// reads & writes -----------------------------------@/
+	// everything page-mapped also works through these.
+	// reads without checking watchpoints, for debuggers. IO registers
+	// that can't be read are $FF, instead of stopping.
+	auto CMem::peek(size_t addr) -> uint32_t {
+		m_peeking = true;
+		const uint32_t value = read_unwatched(addr);
+		m_peeking = false;
+		return value;
+	}
+	auto CMem::read_slow(size_t addr) -> uint32_t {
+		addr &= 0xFFFF;
+		const uint32_t value = read_unwatched(addr);
+		if(m_watchPages[addr>>8] & WatchKind::read) watch_read(addr,value);
+		return value;
+	}
+	auto CMem::read_unwatched(size_t addr) -> uint32_t {
 		addr &= 0xFFFF;
 		auto addr_hi = addr >> 8;
 		auto addr_lo = addr & 0xFF;
@@ -83,30 +165,32 @@ namespace fern {
 		// bit 15 clear: ROM read
 		// bit 15 set: RAM read
 		if((addr>>15) == 0) {
-			return m_mapper->read_rom(addr);
+			// the bank's latched on ROM writes, no need to ask the mapper
+			const int bank = (addr >> 14) ? m_rombankLatched : 0;
+			return checked_at(m_rombanks,bank).data[addr & 0x3FFF];
 		} else {
 			// $8000-$9FFF : VRAM
 			if(addr_hi >= 0x80 && addr_hi <= 0x9F) {
-				return m_vram.at(addr & 0x1FFF);
+				return masked_at(m_vram,(addr & 0x1FFF) + KBSIZE(8) * m_io.m_VBK);
 			}
 			// $A000-$BFFF : SRAM
 			else if(addr_hi >= 0xA0 && addr_hi <= 0xBF) {
-				return m_mapper->read_sram(addr & 0x1FFF);
+				return std::visit([&](auto& mapper) { return mapper.read_sram(addr & 0x1FFF); },m_mapper);
 			} 
 			// $C000-$DFFF : WRAM
 			else if(addr_hi >= 0xC0 && addr_hi <= 0xDF) {
 				return read_wram(addr & 0x1FFF);
 			}
-			// $E000-$FDFF : HRAM
+			// $E000-$FDFF : echo RAM
 			else if(addr_hi >= 0xE0 && addr_hi <= 0xFD) {
-				return m_wram.at(addr & 0x1FFF);
+				return read_wram(addr & 0x1FFF);
 			}
 			// $FE00-$FE9F : OAM
 			else if(addr_hi == 0xFE) {
 				if(addr_lo >= 0xA0 || !oam_accessible()) {
 					return 0xFF;
 				}
-				return m_oam.at(addr_lo);
+				return checked_at(m_oam,addr_lo);
 			}
 			// $FF00-$FFFF : HRAM
 			else if(addr_hi == 0xFF) {
@@ -128,7 +212,7 @@ namespace fern {
 			addr &= 0xFFF;
 			addr += KBSIZE(4) * wrambank;
 		}
-		return m_wram.at(addr);
+		return masked_at(m_wram,addr);
 	}
 	auto CMem::read_hram(int addr) -> uint32_t {
 		addr &= 0xFF;
@@ -141,16 +225,12 @@ namespace fern {
 				// joypad -------------------------------@/
 				case 0x00: {
 					int paddata = 0xCF;
+					// the packed state's nibbles are already in JOYP order
+					const int joypad = emu()->joypad_state();
 					if(m_io.m_joypmode == fern::JOYPMode::button) {
-						if(emu()->button_held(EmuButton::a)) paddata ^= 0x1;
-						if(emu()->button_held(EmuButton::b)) paddata ^= 0x2;
-						if(emu()->button_held(EmuButton::select)) paddata ^= 0x4;
-						if(emu()->button_held(EmuButton::start)) paddata ^= 0x8;
+						paddata ^= joypad >> 4;
 					} else {
-						if(emu()->button_held(EmuButton::right)) paddata ^= 0x1;
-						if(emu()->button_held(EmuButton::left)) paddata ^= 0x2;
-						if(emu()->button_held(EmuButton::up)) paddata ^= 0x4;
-						if(emu()->button_held(EmuButton::down)) paddata ^= 0x8;
+						paddata ^= joypad & 0xF;
 					}
 					//std::printf("pad: %1Xh (mode: %d)\n",paddata,m_io.m_joypmode);
 					return paddata;
@@ -159,7 +239,10 @@ namespace fern {
 				case 0x01: return 0;
 				case 0x02: return m_io.m_SC;
 				// timer --------------------------------@/
-				case 0x04: return m_io.m_DIV;
+				case 0x04: return emu()->cpu.timer_div();
+				case 0x05: return emu()->cpu.timer_tima();
+				case 0x06: return m_io.m_TMA;
+				case 0x07: return m_io.m_TAC | 0xF8;
 				// misc ---------------------------------@/
 				case 0x0F: return m_io.m_IF;
 				// sound --------------------------------@/
@@ -196,6 +279,7 @@ namespace fern {
 				case 0x70: return m_io.m_SVBK;
 				// unknown ------------------------------@/
 				default: {
+					if(m_peeking) return 0xFF;
 					std::printf("unimplemented: IO read (%02Xh)\n",addr);
 					std::exit(-1);
 					return 0;
@@ -205,6 +289,25 @@ namespace fern {
 	}
 	
 	auto CMem::write(size_t addr,int data) -> void {
+		addr &= 0xFFFF;
+#ifdef FERN_CPUCORE_CACHED
+		emu()->cpu.blockcache_written(addr);
+#endif
+		if(uint8_t* page = m_pageWrite[addr>>8]) {
+			page[addr & 0xFF] = data;
+			return;
+		}
+		write_slow(addr,data);
+	}
+	auto CMem::write_slow(size_t addr,int data) -> void {
+		addr &= 0xFFFF;
+		if(m_watchPages[addr>>8] & (WatchKind::write | WatchKind::change)) {
+			watch_write(addr,data);
+			return;
+		}
+		write_unwatched(addr,data);
+	}
+	auto CMem::write_unwatched(size_t addr,int data) -> void {
 		data &= 0xFF;
 		addr &= 0xFFFF;
 		auto addr_hi = addr >> 8;
@@ -213,7 +316,8 @@ namespace fern {
 		// bit 15 clear: ROM access
 		// bit 15 set: RAM access
 		if((addr>>15) == 0) {
-			m_mapper->write_rom(addr,data);
+			std::visit([&](auto& mapper) { mapper.write_rom(addr,data); },m_mapper);
+			rombank_latch();
 		} else {
 			// VRAM
 			if(addr_hi >= 0x80 && addr_hi <= 0x9F) {
@@ -221,7 +325,7 @@ namespace fern {
 			}
 			// SRAM
 			else if(addr_hi >= 0xA0 && addr_hi <= 0xBF) {
-				m_mapper->write_sram(addr & 0x1FFF,data);
+				std::visit([&](auto& mapper) { mapper.write_sram(addr & 0x1FFF,data); },m_mapper);
 			} 
 			// WRAM
 			else if(addr_hi >= 0xC0 && addr_hi <= 0xDF) {
@@ -268,7 +372,7 @@ namespace fern {
 			addr &= 0xFFF;
 			addr += KBSIZE(4) * wrambank;
 		}
-		m_wram.at(addr) = data;
+		masked_at(m_wram,addr) = data;
 	}
 	auto CMem::write_vram(int addr,int data) -> void {
 		addr &= 0x1FFF;
@@ -277,6 +381,7 @@ namespace fern {
 		if(!vram_accessible()) return;
 		addr += KBSIZE(8) * m_io.m_VBK;
 		m_vram[addr] = data;
+		m_vramDirty |= uint64_t(1) << (addr >> 8);
 		//	std::printf("attempt to write to vram in mode 3 (%04Xh)\n",addr);
 		//	emu()->cpu.print_status();
 		//	std::exit(-1);
@@ -287,6 +392,7 @@ namespace fern {
 
 		if(addr == 0xFF) {
 			m_io.m_IE = data & 0b11111;
+			emu()->cpu.clock_reschedule();
 		} else if(addr>>7) {
 			m_hram[addr & 0x7F] = data;
 		} else {
@@ -320,11 +426,11 @@ namespace fern {
 					break;
 				}
 				case 0x04: { // DIV
-					m_io.m_DIV = 0;
+					emu()->cpu.timer_divReset();
 					break;
 				}
 				case 0x05: { // TIMA
-					m_io.m_TIMA = data;
+					emu()->cpu.timer_writeTIMA(data);
 					break;
 				}
 				case 0x06: { // TMA
@@ -332,11 +438,12 @@ namespace fern {
 					break;
 				}
 				case 0x07: { // TAC
-					m_io.m_TAC = data;
+					emu()->cpu.timer_writeTAC(data);
 					break;
 				}
 				case 0x0F: { // IF
 					m_io.m_IF = data & 0b11111;
+					emu()->cpu.clock_reschedule();
 					break;
 				}
 				// sound --------------------------------@/
@@ -446,11 +553,12 @@ namespace fern {
 				}
 				// video --------------------------------@/
 				case 0x40: { // LCDC
+					emu()->cpu.clock_catchup();
+					emu()->cpu.clock_reschedule();
 					if(!m_io.ppu_enabled() && (data & BIT(7))) {
 						m_io.m_LY = 0;
 						emu()->cpu.dotclock_reset();
 						emu()->cpu.m_lycCooldown = true;
-						emu()->renderer.present();
 					}
 				//	std::printf("LCDC write ($%02X)\n",data);
 					/*if(data == 0) {
@@ -458,11 +566,13 @@ namespace fern {
 						emu()->debug_set(true);
 					}*/	
 					m_io.m_LCDC = data;
+					pages_mapVRAM();
 					break;
 				}
 				case 0x41: { // STAT
 					m_io.m_STAT &= 0b111;
 					m_io.m_STAT |= (data & 0b01111000);
+					emu()->cpu.clock_reschedule();
 					break;
 				}
 				case 0x42: { // SCY
@@ -479,6 +589,7 @@ namespace fern {
 				}
 				case 0x45: { // LYC
 					m_io.m_LYC = data;
+					emu()->cpu.clock_reschedule();
 					break;
 				}
 				case 0x46: { // OAM DMA
@@ -532,6 +643,7 @@ namespace fern {
 				case 0x4F: { // VBK
 					if(emu()->cgb_enabled()) {
 						m_io.m_VBK = data & 1;
+						pages_mapVRAM();
 					} else {
 						warn_cgb_reg("VBK",data);
 					}
@@ -662,6 +774,7 @@ namespace fern {
 						int bank = data & 0b111;
 						if(bank == 0) bank = 1;
 						m_io.m_SVBK = bank;
+						pages_mapWRAM();
 					} else {
 						warn_cgb_reg("SVBK",data);
 						emu()->cpu.print_status();
@@ -703,19 +816,75 @@ namespace fern {
 		}
 	}
 
-	// general mapper -----------------------------------@/
-	auto CMapper::error_unimpl(const std::string& message) -> void {
-		std::printf("mapper '%s': error: unimplemented (%s)\n",
-			name().c_str(),message.c_str()
-		);
-		std::exit(-1);
+	// watchpoints --------------------------------------@/
+	// watched pages are unmapped (see pages_map()), so every access to
+	// them comes through read_slow()/write_slow() and ends up here. a hit
+	// stops the CPU once the instruction that did it is done.
+	// reads include DMA and fetching code, in the cores that read it
+	// through CMem.
+	auto CMem::watch_add(int bank,int start,int end,int kind) -> int {
+		m_watchpoints.push_back({ bank,start & 0xFFFF,end & 0xFFFF,kind });
+		watch_pagesUpdate();
+		return m_watchpoints.size() - 1;
+	}
+	auto CMem::watch_remove(int index) -> bool {
+		if(index < 0 || index >= static_cast<int>(m_watchpoints.size())) return false;
+		m_watchpoints.erase(m_watchpoints.begin() + index);
+		watch_pagesUpdate();
+		return true;
+	}
+	auto CMem::watch_pagesUpdate() -> void {
+		m_watchPages.fill(0);
+		for(const auto& wp : m_watchpoints) {
+			for(int page=wp.start>>8; page<=(wp.end>>8); page++) {
+				m_watchPages[page] |= wp.kind;
+			}
+		}
+		pages_mapAll();
 	}
 
-	// none mapper --------------------------------------@/
-	auto CMapperNone::read_rom(size_t addr) -> uint32_t {
-		return m_emu->mem.m_rombanks[0].data[addr & 0x7FFF];
-	};
+	auto CMem::watch_match(int addr,int kind) -> bool {
+		for(const auto& wp : m_watchpoints) {
+			if(!(wp.kind & kind) || addr < wp.start || addr > wp.end) continue;
+			if(wp.bank < 0 || wp.bank == emu()->cpu.code_bank(addr)) return true;
+		}
+		return false;
+	}
+	auto CMem::watch_read(int addr,int value) -> void {
+		if(watch_match(addr,WatchKind::read)) {
+			watch_fire(WatchKind::read,addr,value,value);
+		}
+	}
+	// does the write, and checks it against what was there before.
+	auto CMem::watch_write(int addr,int data) -> void {
+		const bool on_write = watch_match(addr,WatchKind::write);
+		const bool on_change = watch_match(addr,WatchKind::change);
+		const int old_value = (on_write || on_change) ? peek(addr) : 0;
+		write_unwatched(addr,data);
+		if(!on_write && !on_change) return;
+
+		const int new_value = peek(addr);
+		if(on_write) {
+			watch_fire(WatchKind::write,addr,old_value,new_value);
+		} else if(new_value != old_value) {
+			watch_fire(WatchKind::change,addr,old_value,new_value);
+		}
+	}
+	// only the first hit's kept until the debugger's seen it.
+	auto CMem::watch_fire(int kind,int addr,int old_value,int new_value) -> void {
+		auto& cpu = emu()->cpu;
+		if(m_watchFired) return;
+		m_watchFired = true;
+		m_watchHit.kind = kind;
+		m_watchHit.bank = cpu.code_bank(addr);
+		m_watchHit.addr = addr;
+		m_watchHit.old_value = old_value;
+		m_watchHit.new_value = new_value;
+		m_watchHit.pc = (cpu.instrhistory_size() > 0) ? cpu.instrhistory_get(0).pc : -1;
+		cpu.break_stop();
+	}
 
+	// none mapper --------------------------------------@/
 	auto CMapperNone::read_sram(size_t addr) -> uint32_t {
 		//error_unimpl("true SRAM read");
 		return 0xFF;
@@ -736,16 +905,6 @@ namespace fern {
 		m_useram = use_ram;
 		m_usebattery = use_battery;
 	}
-	
-	auto CMapperMBC1::read_rom(size_t addr) -> uint32_t {
-		if((addr>>14) == 0) {
-			return m_emu->mem.m_rombanks[0].data[addr];
-		}
-		
-		addr &= 0x3FFF;
-		
-		return m_emu->mem.m_rombanks[rombank_get()].data[addr];
-	};
 
 	auto CMapperMBC1::read_sram(size_t addr) -> uint32_t {
 		if(!m_useram) { return 0; }
@@ -845,14 +1004,7 @@ namespace fern {
 		m_rtcDay = 0;
 		m_rtcSec = m_rtcMin = m_rtcHour = 0;
 	}
-	
-	auto CMapperMBC3::read_rom(size_t addr) -> uint32_t {
-		if((addr>>14) == 0) {
-			return m_emu->mem.m_rombanks[0].data[addr];
-		}
-		addr &= 0x3FFF;
-		return m_emu->mem.m_rombanks[rombank_get()].data[addr];
-	};
+
 	auto CMapperMBC3::read_sram(size_t addr) -> uint32_t {
 		if(!m_useram) { return 0; }
 		
@@ -967,14 +1119,7 @@ namespace fern {
 		m_usebattery = use_battery;
 		m_userumble = use_rumble;
 	}
-	
-	auto CMapperMBC5::read_rom(size_t addr) -> uint32_t {
-		if((addr>>14) == 0) {
-			return m_emu->mem.m_rombanks[0].data[addr];
-		}
-		addr &= 0x3FFF;
-		return m_emu->mem.m_rombanks[rombank_get()].data[addr];
-	};
+
 	auto CMapperMBC5::read_sram(size_t addr) -> uint32_t {
 		if(!m_useram) { return 0; }
 		
@@ -0,0 +1,118 @@
+#include <fern.h>
+#include <fern_common.h>
+#include <algorithm>
+
+// PPU worker ---------------------------------------------------------------@/
+// draw_line() hands each line to a worker thread instead of drawing it, so
+// the CPU can carry on with the next one. the line's registers, OAM and
+// palettes are copied as they are when it's queued, along with any VRAM
+// pages written since the last line, so it's drawn exactly as the CPU
+// thread would have drawn it.
+// present() waits for the worker to catch up before it reads the screen.
+#ifdef FERN_PPU_THREAD
+namespace fern {
+	auto CRenderer::ppu_start() -> void {
+		m_ppuRing.resize(PPU_RING_SIZE);
+		m_ppuHead = 0;
+		m_ppuTail = 0;
+		m_ppuIdle = false;
+		m_ppuWaiting = false;
+		m_ppuStopping = false;
+		// the worker's copy of VRAM starts off empty
+		emu()->mem.m_vramDirty = ~uint64_t(0);
+		m_ppuThread = std::thread(&CRenderer::ppu_thread,this);
+	}
+	auto CRenderer::ppu_stop() -> void {
+		if(!m_ppuThread.joinable()) return;
+		{
+			std::unique_lock<std::mutex> lock(m_ppuMutex);
+			m_ppuStopping = true;
+		}
+		m_ppuCond.notify_all();
+		m_ppuThread.join();
+	}
+
+	auto CRenderer::ppu_queue(int draw_y) -> void {
+		if(draw_y < 0 || draw_y >= fern::SCREEN_Y) return;
+		if(!m_ppuThread.joinable()) ppu_start();
+
+		const uint32_t head = m_ppuHead.load(std::memory_order_relaxed);
+		if(head - m_ppuTail.load(std::memory_order_acquire) >= PPU_RING_SIZE) {
+			ppu_wait(PPU_RING_SIZE - 1);
+		}
+
+		auto& mem = emu()->mem;
+		auto& job = m_ppuRing[head % PPU_RING_SIZE];
+		job.draw_y = draw_y;
+		job.input = line_input();
+		job.oam = mem.m_oam;
+		job.paletBG = mem.m_paletBG;
+		job.paletObj = mem.m_paletObj;
+		job.vram_dirty = mem.m_vramDirty;
+		for(uint64_t dirty = mem.m_vramDirty; dirty != 0; dirty &= dirty - 1) {
+			const int page = __builtin_ctzll(dirty);
+			std::copy_n(&mem.m_vram[page << 8],0x100,&job.vram[page << 8]);
+		}
+		mem.m_vramDirty = 0;
+
+		// seq_cst, so either the worker sees the new head before it sleeps
+		// or this sees that it's asleep. it's only woken once a few lines
+		// have built up, since waking it every line costs more than a line.
+		m_ppuHead.store(head + 1);
+		if(m_ppuIdle.load() && (head + 1) - m_ppuTail.load() >= PPU_WAKE_LINES) {
+			std::unique_lock<std::mutex> lock(m_ppuMutex);
+			m_ppuCond.notify_all();
+		}
+	}
+	auto CRenderer::ppu_sync() -> void {
+		if(!m_ppuThread.joinable()) return;
+		ppu_wait(0);
+	}
+	// waits until there's no more than pending lines left to draw
+	auto CRenderer::ppu_wait(uint32_t pending) -> void {
+		auto done = [&]() {
+			return m_ppuHead.load(std::memory_order_relaxed) - m_ppuTail.load() <= pending;
+		};
+		if(done()) return;
+		std::unique_lock<std::mutex> lock(m_ppuMutex);
+		m_ppuWaiting = true;
+		m_ppuCond.notify_all(); // the worker might be waiting for more lines
+		m_ppuCond.wait(lock,done);
+		m_ppuWaiting = false;
+	}
+
+	auto CRenderer::ppu_thread() -> void {
+		CLineInput input;
+		while(true) {
+			const uint32_t tail = m_ppuTail.load(std::memory_order_relaxed);
+			if(tail == m_ppuHead.load()) {
+				std::unique_lock<std::mutex> lock(m_ppuMutex);
+				m_ppuIdle = true;
+				m_ppuCond.wait(lock,[&]() { return tail != m_ppuHead.load() || m_ppuStopping; });
+				m_ppuIdle = false;
+				if(tail == m_ppuHead.load()) break; // stopping, and nothing left
+			}
+
+			const auto& job = m_ppuRing[tail % PPU_RING_SIZE];
+			for(uint64_t dirty = job.vram_dirty; dirty != 0; dirty &= dirty - 1) {
+				const int page = __builtin_ctzll(dirty);
+				std::copy_n(&job.vram[page << 8],0x100,&m_ppuVRAM[page << 8]);
+			}
+			input = job.input;
+			input.vram = &m_ppuVRAM;
+			input.oam = &job.oam;
+			input.paletBG = &job.paletBG;
+			input.paletObj = &job.paletObj;
+			if(emu()->cgb_enabled()) draw_lineCGB(job.draw_y,input);
+			else draw_lineDMG(job.draw_y,input);
+
+			// same as ppu_queue(), the other way around
+			m_ppuTail.store(tail + 1);
+			if(m_ppuWaiting.load()) {
+				std::unique_lock<std::mutex> lock(m_ppuMutex);
+				m_ppuCond.notify_all();
+			}
+		}
+	}
+}
+#endif
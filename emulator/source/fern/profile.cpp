@@ -0,0 +1,396 @@
+#include <fern.h>
+#include <fern_common.h>
+#include <algorithm>
+#include <vector>
+#include <map>
+
+// profiler -----------------------------------------------------------------@/
+// each instruction's charged the cycles from when it starts to when the
+// next one does, so an interrupt taken at its end, or halting, counts
+// towards it. skipped idle loop iterations (see cpu_idle.cpp) go to the
+// loop's jr, but aren't counted as runs.
+// PCs are counted by bank too, and grouped by the nearest label below them
+// for the hotspot report, when there's a .sym file.
+// the call graph only does anything on calls, rsts, returns & interrupts:
+// cycles since the last one go to whichever function's on top of the
+// shadow stack. returns unwind by SP, so frames left behind by code that
+// pops its return address are dropped once something further out returns.
+// interrupt handlers start their own stacks, and their cycles don't count
+// towards what they interrupted.
+#ifdef FERN_PROFILE
+
+namespace {
+	auto profile_cbName(int cb_opcode) -> std::string {
+		static const char* const regs[8] = { "b","c","d","e","h","l","[hl]","a" };
+		static const char* const shifts[8] = { "rlc","rrc","rl","rr","sla","sra","swap","srl" };
+		static const char* const bitops[4] = { "","bit","res","set" };
+		char name[16];
+		if(cb_opcode < 0x40) {
+			std::snprintf(name,sizeof(name),"%s %s",shifts[cb_opcode>>3],regs[cb_opcode & 7]);
+		} else {
+			std::snprintf(name,sizeof(name),"%s %d,%s",
+				bitops[cb_opcode>>6],(cb_opcode>>3) & 7,regs[cb_opcode & 7]
+			);
+		}
+		return name;
+	}
+	// which part of the memory map addr's in. labels only cover PCs in
+	// the same part and bank as them.
+	auto profile_region(int addr) -> int {
+		if(addr < 0x4000) return 0;
+		if(addr < 0x8000) return 1;
+		if(addr < 0xA000) return 2;
+		if(addr < 0xC000) return 3;
+		if(addr < 0xD000) return 4;
+		if(addr < 0xE000) return 5;
+		return 6;
+	}
+	auto profile_spotName(uint32_t key) -> std::string {
+		char name[16];
+		std::snprintf(name,sizeof(name),"%02X:%04X",key>>16,key & 0xFFFF);
+		return name;
+	}
+	// function label for a label: Func.loop goes under Func
+	auto profile_labelFunction(const std::string& label) -> std::string {
+		const auto dot = label.find('.');
+		return (dot == std::string::npos) ? label : label.substr(0,dot);
+	}
+	auto profile_irqIndex(int vector) -> int {
+		return (vector - 0x40) / 8;
+	}
+	const char* const PROFILE_IRQNAMES[3] = { "vblank","STAT","timer" };
+}
+
+namespace fern {
+	auto CCPU::profile_enable(bool enable) -> void {
+		m_profileEnabled = enable;
+		m_profileLast = -1;
+		// whatever was on the stack before isn't known
+		profile_stackReset();
+	}
+	auto CCPU::profile_reset() -> void {
+		m_profileOpcodes.fill({});
+		m_profileSpots.clear();
+		m_profileLast = -1;
+		m_profileLastSpot = nullptr;
+		m_profileStart = m_clockCycles;
+		m_profileFunctions.clear();
+		m_profileIrqs.fill({});
+		profile_stackReset();
+	}
+	auto CCPU::profile_count(int opcode,int pc) -> void {
+		if(m_profileLast >= 0) {
+			const uint64_t cycles = m_clockCycles - m_profileStart;
+			m_profileOpcodes[m_profileLast].cycles += cycles;
+			m_profileLastSpot->cycles += cycles;
+		}
+		if(opcode == 0xCB) {
+			opcode = 0x100 | m_emu->mem.peek(pc + 1);
+		}
+		m_profileOpcodes[opcode].count += 1;
+		m_profileLast = opcode;
+		// map entries don't move, so this stays good until the next reset
+		m_profileLastSpot = &m_profileSpots[profile_spotKey(pc)];
+		m_profileLastSpot->count += 1;
+		m_profileStart = m_clockCycles;
+	}
+	auto CCPU::profile_spotKey(int pc) -> uint32_t {
+		return (code_bank(pc)<<16) | pc;
+	}
+	// the nearest label at or below key, or null if there's none.
+	auto CCPU::profile_symbolFind(uint32_t key) -> const CProfileSymbol* {
+		auto found = std::upper_bound(m_profileSymbols.begin(),m_profileSymbols.end(),key,
+			[](uint32_t value,const CProfileSymbol& sym) { return value < sym.key; }
+		);
+		if(found == m_profileSymbols.begin()) return nullptr;
+		--found;
+		const bool same_bank = (found->key>>16) == (key>>16);
+		if(!same_bank || profile_region(found->key & 0xFFFF) != profile_region(key & 0xFFFF)) {
+			return nullptr;
+		}
+		return &*found;
+	}
+
+	// RGBDS .sym files: one `bank:addr label` per line, ; for comments.
+	// local labels are written as Func.local; ones written as just .local
+	// get the last full label put in front.
+	auto CCPU::profile_loadSymbols(const std::string& filename) -> bool {
+		auto file = std::fopen(filename.c_str(),"r");
+		if(!file) return false;
+
+		m_profileSymbols.clear();
+		std::string last_global;
+		char line[512];
+		while(std::fgets(line,sizeof(line),file)) {
+			unsigned int bank = 0;
+			unsigned int addr = 0;
+			char label[256] = {};
+			if(line[0] == ';') continue;
+			if(std::sscanf(line,"%x:%x %255s",&bank,&addr,label) != 3) continue;
+
+			std::string name = label;
+			if(name[0] == '.') {
+				name = last_global + name;
+			} else if(name.find('.') == std::string::npos) {
+				last_global = name;
+			}
+			m_profileSymbols.push_back({ ((bank & 0xFFFF)<<16) | (addr & 0xFFFF),name });
+		}
+		std::fclose(file);
+
+		std::stable_sort(m_profileSymbols.begin(),m_profileSymbols.end(),
+			[](const CProfileSymbol& a,const CProfileSymbol& b) { return a.key < b.key; }
+		);
+		std::printf("profiler: %zu labels from '%s'\n",m_profileSymbols.size(),filename.c_str());
+		return true;
+	}
+
+	// call graph ---------------------------------------@/
+	// the stack starts with the function running when profiling started
+	// (from reset, that's the entry point).
+	auto CCPU::profile_stackReset() -> void {
+		m_profileNodes.clear();
+		m_profileNodeIndex.clear();
+		m_profileStack.clear();
+		m_profileNodes.push_back({ -1,static_cast<uint32_t>(m_PC & 0xFFFF),0,0 });
+		m_profileStack.push_back({ 0,0x10000,0,0 });
+		m_profileStackClock = m_clockCycles;
+	}
+	// gives the cycles since the stack last changed to the function on top.
+	auto CCPU::profile_stackCharge() -> void {
+		const uint64_t cycles = m_clockCycles - m_profileStackClock;
+		auto& frame = m_profileStack.back();
+		frame.self += cycles;
+		m_profileNodes[frame.node].self += cycles;
+		m_profileStackClock = m_clockCycles;
+	}
+	auto CCPU::profile_enter(int addr,int sp,int irq) -> void {
+		profile_stackCharge();
+		if(m_profileStack.size() >= PROFILE_MAXDEPTH) return;
+
+		const uint32_t key = profile_spotKey(addr & 0xFFFF);
+		const int parent = irq ? -1 : m_profileStack.back().node;
+		const uint64_t index_key = (static_cast<uint64_t>(static_cast<uint32_t>(parent))<<32) | key;
+		auto [found,added] = m_profileNodeIndex.try_emplace(index_key,m_profileNodes.size());
+		if(added) {
+			m_profileNodes.push_back({ parent,key,irq,0 });
+		}
+		m_profileStack.push_back({ found->second,sp,0,0 });
+
+		m_profileFunctions[key].calls += 1;
+		if(irq) {
+			m_profileIrqs[profile_irqIndex(irq)].calls += 1;
+		}
+	}
+	auto CCPU::profile_leave(int sp) -> void {
+		profile_stackCharge();
+		// the bottom frame never returns
+		while(m_profileStack.size() > 1 && m_profileStack.back().sp < sp) {
+			const auto frame = m_profileStack.back();
+			m_profileStack.pop_back();
+
+			const auto& node = m_profileNodes[frame.node];
+			const uint64_t inclusive = frame.self + frame.children;
+			auto& func = m_profileFunctions[node.key];
+			func.inclusive += inclusive;
+			func.exclusive += frame.self;
+			if(node.irq) {
+				auto& irq = m_profileIrqs[profile_irqIndex(node.irq)];
+				irq.inclusive += inclusive;
+				irq.exclusive += frame.self;
+			} else {
+				m_profileStack.back().children += inclusive;
+			}
+		}
+	}
+	// label (or bank:addr) for a node's function.
+	auto CCPU::profile_nodeName(int node) -> std::string {
+		const uint32_t key = m_profileNodes[node].key;
+		if(auto sym = profile_symbolFind(key)) {
+			return profile_labelFunction(sym->name);
+		}
+		return profile_spotName(key);
+	}
+
+	// one line per call stack, as Outer;Inner cycles. interrupt handlers'
+	// stacks start with [vblank], [STAT] or [timer].
+	auto CCPU::profile_writeCollapsed(const std::string& filename) -> bool {
+		profile_stackCharge();
+		std::map<std::string,uint64_t> stacks;
+		for(int i=0; i<static_cast<int>(m_profileNodes.size()); i++) {
+			if(m_profileNodes[i].self == 0) continue;
+			std::string stack;
+			int node = i;
+			while(node >= 0) {
+				std::string frame = profile_nodeName(node);
+				if(m_profileNodes[node].irq) {
+					frame = std::string("[") + PROFILE_IRQNAMES[profile_irqIndex(m_profileNodes[node].irq)] + "];" + frame;
+				}
+				stack = stack.empty() ? frame : frame + ";" + stack;
+				node = m_profileNodes[node].parent;
+			}
+			stacks[stack] += m_profileNodes[i].self;
+		}
+
+		auto file = std::fopen(filename.c_str(),"w");
+		if(!file) {
+			std::printf("warning: couldn't write '%s'\n",filename.c_str());
+			return false;
+		}
+		for(const auto& [stack,cycles] : stacks) {
+			std::fprintf(file,"%s %llu\n",stack.c_str(),static_cast<unsigned long long>(cycles));
+		}
+		std::fclose(file);
+		std::printf("profiler: collapsed stacks written to '%s'\n",filename.c_str());
+		return true;
+	}
+
+	// prints every opcode that's run, then the hottest functions (or PCs,
+	// without labels). most cycles first.
+	auto CCPU::profile_report() -> void {
+		// the running instruction's cycles so far
+		if(m_profileLast >= 0) {
+			const uint64_t cycles = m_clockCycles - m_profileStart;
+			m_profileOpcodes[m_profileLast].cycles += cycles;
+			m_profileLastSpot->cycles += cycles;
+			m_profileStart = m_clockCycles;
+		}
+
+		std::vector<int> entries;
+		uint64_t total_count = 0;
+		uint64_t total_cycles = 0;
+		for(int i=0; i<PROFILE_OPCODES; i++) {
+			const auto& entry = m_profileOpcodes[i];
+			if(entry.count == 0) continue;
+			entries.push_back(i);
+			total_count += entry.count;
+			total_cycles += entry.cycles;
+		}
+		std::stable_sort(entries.begin(),entries.end(),[&](int a,int b) {
+			return m_profileOpcodes[a].cycles > m_profileOpcodes[b].cycles;
+		});
+
+		std::printf("opcode profile: %llu instructions, %llu cycles\n",
+			static_cast<unsigned long long>(total_count),
+			static_cast<unsigned long long>(total_cycles)
+		);
+		std::printf("%-4s %-16s %12s %16s %11s %8s\n","op","name","count","cycles","cyc/op","cycles%");
+		for(auto i : entries) {
+			const auto& entry = m_profileOpcodes[i];
+			const std::string name = (i < 0x100) ? m_opcodetable[i].name : profile_cbName(i & 0xFF);
+			const double percent = total_cycles ? (100.0 * entry.cycles) / total_cycles : 0.0;
+			std::printf("%s%02X %-16s %12llu %16llu %11.2f %7.2f%%\n",
+				(i < 0x100) ? "  " : "CB",i & 0xFF,name.c_str(),
+				static_cast<unsigned long long>(entry.count),
+				static_cast<unsigned long long>(entry.cycles),
+				static_cast<double>(entry.cycles) / entry.count,
+				percent
+			);
+		}
+
+		// hotspots, by function
+		constexpr int HOTSPOT_COUNT = 40;
+		std::map<std::string,CProfileCount> functions;
+		for(const auto& [key,spot] : m_profileSpots) {
+			auto sym = profile_symbolFind(key);
+			auto& func = functions[sym ? profile_labelFunction(sym->name) : profile_spotName(key)];
+			func.count += spot.count;
+			func.cycles += spot.cycles;
+		}
+		std::vector<std::pair<std::string,CProfileCount>> hotspots(functions.begin(),functions.end());
+		std::stable_sort(hotspots.begin(),hotspots.end(),[](const auto& a,const auto& b) {
+			return a.second.cycles > b.second.cycles;
+		});
+		if(hotspots.size() > HOTSPOT_COUNT) hotspots.resize(HOTSPOT_COUNT);
+		auto percent_of = [&](uint64_t cycles) {
+			return total_cycles ? (100.0 * cycles) / total_cycles : 0.0;
+		};
+
+		std::printf("hotspots (%s):\n",m_profileSymbols.empty() ? "by PC, no labels loaded" : "by label");
+		std::printf("%-24s %16s %16s %8s\n","label","count","cycles","cycles%");
+		for(const auto& [name,func] : hotspots) {
+			std::printf("%-24s %16llu %16llu %7.2f%%\n",name.c_str(),
+				static_cast<unsigned long long>(func.count),
+				static_cast<unsigned long long>(func.cycles),
+				percent_of(func.cycles)
+			);
+		}
+
+		// call graph. frames still on the stack count as if they'd returned.
+		profile_stackCharge();
+		auto functions_now = m_profileFunctions;
+		auto irqs_now = m_profileIrqs;
+		uint64_t children = 0;
+		for(int i=m_profileStack.size()-1; i>=0; i--) {
+			const auto& frame = m_profileStack[i];
+			const auto& node = m_profileNodes[frame.node];
+			const uint64_t inclusive = frame.self + frame.children + children;
+			functions_now[node.key].inclusive += inclusive;
+			functions_now[node.key].exclusive += frame.self;
+			children = inclusive;
+			if(node.irq) {
+				irqs_now[profile_irqIndex(node.irq)].inclusive += inclusive;
+				irqs_now[profile_irqIndex(node.irq)].exclusive += frame.self;
+				children = 0;
+			}
+		}
+		// calls into the middle of a function go under its label too
+		std::map<std::string,CProfileFunction> functions_named;
+		for(const auto& [key,func] : functions_now) {
+			auto sym = profile_symbolFind(key);
+			auto& named = functions_named[sym ? profile_labelFunction(sym->name) : profile_spotName(key)];
+			named.calls += func.calls;
+			named.inclusive += func.inclusive;
+			named.exclusive += func.exclusive;
+		}
+		std::vector<std::pair<std::string,CProfileFunction>> calls(functions_named.begin(),functions_named.end());
+		std::stable_sort(calls.begin(),calls.end(),[](const auto& a,const auto& b) {
+			return a.second.inclusive > b.second.inclusive;
+		});
+		if(calls.size() > HOTSPOT_COUNT) calls.resize(HOTSPOT_COUNT);
+
+		std::puts("call graph (cycles):");
+		std::printf("%-24s %12s %16s %8s %16s %8s\n","function","calls","inclusive","incl%","exclusive","excl%");
+		for(const auto& [name,func] : calls) {
+			std::printf("%-24s %12llu %16llu %7.2f%% %16llu %7.2f%%\n",name.c_str(),
+				static_cast<unsigned long long>(func.calls),
+				static_cast<unsigned long long>(func.inclusive),percent_of(func.inclusive),
+				static_cast<unsigned long long>(func.exclusive),percent_of(func.exclusive)
+			);
+		}
+		std::puts("interrupt handlers (cycles):");
+		std::printf("%-24s %12s %16s %8s %16s\n","interrupt","taken","inclusive","incl%","per interrupt");
+		for(int i=0; i<3; i++) {
+			const auto& irq = irqs_now[i];
+			std::printf("%-24s %12llu %16llu %7.2f%% %16.1f\n",PROFILE_IRQNAMES[i],
+				static_cast<unsigned long long>(irq.calls),
+				static_cast<unsigned long long>(irq.inclusive),percent_of(irq.inclusive),
+				irq.calls ? static_cast<double>(irq.inclusive) / irq.calls : 0.0
+			);
+		}
+	}
+}
+
+#else
+
+namespace fern {
+	auto CCPU::profile_enable(bool enable) -> void {
+		if(enable) {
+			std::puts("warning: the profiler isn't built in (build with PROFILE=1)");
+		}
+	}
+	auto CCPU::profile_reset() -> void {}
+	auto CCPU::profile_report() -> void {}
+	auto CCPU::profile_count(int opcode,int pc) -> void {}
+	auto CCPU::profile_spotKey(int pc) -> uint32_t { return pc; }
+	auto CCPU::profile_symbolFind(uint32_t key) -> const CProfileSymbol* { return nullptr; }
+	auto CCPU::profile_loadSymbols(const std::string& filename) -> bool { return false; }
+	auto CCPU::profile_writeCollapsed(const std::string& filename) -> bool { return false; }
+	auto CCPU::profile_stackReset() -> void {}
+	auto CCPU::profile_stackCharge() -> void {}
+	auto CCPU::profile_enter(int addr,int sp,int irq) -> void {}
+	auto CCPU::profile_leave(int sp) -> void {}
+	auto CCPU::profile_nodeName(int node) -> std::string { return {}; }
+}
+
+#endif
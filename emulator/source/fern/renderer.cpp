@@ -33,8 +33,32 @@ namespace fern {
 		m_windowVRAM = nullptr;
 		m_windowPalet = nullptr;
 		m_vsyncEnabled = false;
+#ifdef FERN_PPU_THREAD
+		m_ppuHead = 0;
+		m_ppuTail = 0;
+		m_ppuIdle = false;
+		m_ppuWaiting = false;
+		m_ppuStopping = false;
+#endif
 	}
 	CRenderer::~CRenderer() {
+#ifdef FERN_PPU_THREAD
+		ppu_stop();
+#endif
+	}
+	auto CRenderer::line_input() -> CLineInput {
+		const auto& mem = emu()->mem;
+		return {
+			mem.m_io.m_LCDC,
+			mem.m_io.m_SCX,mem.m_io.m_SCY,
+			mem.m_io.m_WX,mem.m_io.m_WY,
+			mem.m_io.m_BGP,
+			{ mem.m_io.m_OBP[0],mem.m_io.m_OBP[1] },
+			&mem.m_vram,
+			&mem.m_oam,
+			&mem.m_paletBG,
+			&mem.m_paletObj
+		};
 	}
 
 	auto CRenderer::window_close() -> void {
@@ -251,7 +275,19 @@ namespace fern {
 		}
 	}
 
+#ifndef FERN_PPU_THREAD
+	// (the PPU worker makes the same choice in ppu_thread())
+	auto CRenderer::draw_line(int draw_y) -> void {
+		const auto input = line_input();
+		if(emu()->cgb_enabled()) draw_lineCGB(draw_y,input);
+		else draw_lineDMG(draw_y,input);
+	}
+#endif
+
+	// copies everything to the window surfaces. this reads the emulator's
+	// state, so it's done while the emulation thread waits.
 	auto CRenderer::present() -> void {
+		ppu_sync();
 		render_vramwindow();
 		render_palwindow();
 		if(auto surface = SDL_GetWindowSurface(m_window)) {
@@ -263,7 +299,10 @@ namespace fern {
 		if(auto surface = SDL_GetWindowSurface(m_windowPalet)) {
 			m_screenPalet.render_toSurface(surface);
 		}
-
+		m_vramMarker.fill(-1);
+	}
+	// waits for the next frame, then shows the surfaces.
+	auto CRenderer::flip() -> void {
 		if(!emu()->nowait_isEnabled()) {
 			// wait til next frame
 			if(!vsync_enabled()) {
@@ -277,25 +316,17 @@ namespace fern {
 			}
 		}
 		m_timeLastFrame = SDL_GetTicks();
-		m_vramMarker.fill(-1);
 
 		SDL_UpdateWindowSurface(m_window);
 		SDL_UpdateWindowSurface(m_windowVRAM);
 		SDL_UpdateWindowSurface(m_windowPalet);
 	}
-	auto CRenderer::draw_line(int draw_y) -> void {
-		if(emu()->cgb_enabled()) {
-			draw_lineCGB(draw_y);
-		} else {
-			draw_lineDMG(draw_y);
-		}
-	}
-
-	auto CRenderer::draw_lineCGB(int draw_y) -> void {
+	auto CRenderer::draw_lineCGB(int draw_y,const CLineInput& in) -> void {
 		if(draw_y < 0 || draw_y >= 144) return;
 
-		auto& mem = emu()->mem;
-		const int lcdc = mem.m_io.m_LCDC;
+		const auto& vram = *in.vram;
+		const auto& oam = *in.oam;
+		const int lcdc = in.lcdc;
 		std::array<char,fern::SCREEN_X> bg_linebuffer;
 
 		auto palet_getTrue = [&](const auto& src_mem) {
@@ -306,8 +337,8 @@ namespace fern {
 			}
 			return palet;
 		};
-		const auto palet_BG = palet_getTrue(mem.m_paletBG);
-		const auto palet_obj = palet_getTrue(mem.m_paletObj);
+		const auto palet_BG = palet_getTrue(*in.paletBG);
+		const auto palet_obj = palet_getTrue(*in.paletObj);
 
 		// draw backplane, if lcd's off -----------------@/
 		if(!(lcdc & RFlagLCDC::lcdon)) {
@@ -320,8 +351,8 @@ namespace fern {
 
 		// draw background ------------------------------@/
 		{
-			const int bgscroll_x = mem.m_io.m_SCX;
-			const int bgscroll_y = mem.m_io.m_SCY;
+			const int bgscroll_x = in.scx;
+			const int bgscroll_y = in.scy;
 			
 			const int fetch_y = (bgscroll_y + draw_y) & 0xFF;
 			size_t addr_chrbase = 0x0800;
@@ -338,19 +369,19 @@ namespace fern {
 					// fetch tile
 					const int mapaddr = addr_mapline + (fetch_x/8);
 					const int mapaddr_attrib = mapaddr + KBSIZE(8);
-					const int attrib = mem.m_vram.at(mapaddr_attrib);
+					const int attrib = masked_at(vram,mapaddr_attrib);
 					int attrib_paletnum = attrib & 7;
 					int attrib_banknum = RFlagMapAttrib::bank(attrib);
 
 					int tile = 0;
 					if(lcdc & RFlagLCDC::chr8000) {
-						tile = mem.m_vram.at(mapaddr);
+						tile = masked_at(vram,mapaddr);
 					} else {
-						tile = static_cast<int8_t>(mem.m_vram.at(mapaddr));
+						tile = static_cast<int8_t>(masked_at(vram,mapaddr));
 						tile = (tile + 0x80) & 0xFF;
 					}
 					int tileaddr = (KBSIZE(8) * attrib_banknum) + addr_chrbase + tile * 0x10;
-					m_vramMarker.at(tileaddr / 0x10) = attrib_paletnum;
+					masked_at(m_vramMarker,tileaddr / 0x10) = attrib_paletnum;
 					
 					// get pixel
 					int tileY = (fetch_y&7);
@@ -358,8 +389,8 @@ namespace fern {
 					if(RFlagMapAttrib::flipX(attrib)) tileX = 7-tileX;
 					if(RFlagMapAttrib::flipY(attrib)) tileY = 7-tileY;
 					tileaddr += tileY*2;
-					int lineA = mem.m_vram[tileaddr];
-					int lineB = mem.m_vram[tileaddr+1];
+					int lineA = masked_at(vram,tileaddr);
+					int lineB = masked_at(vram,tileaddr+1);
 					int dotA = (lineA >> (7-tileX)) & 1;
 					int dotB = (lineB >> (7-tileX)) & 1;
 					dot = dotA | (dotB<<1);
@@ -373,17 +404,17 @@ namespace fern {
 		}
 	
 		// draw sprites ---------------------------------@/
-		const bool spr_size2x = (mem.m_io.m_LCDC & 0x04) != 0;
+		const bool spr_size2x = (lcdc & 0x04) != 0;
 		const int spr_height = spr_size2x ? 16 : 8;
 		const int spr_tilemask = spr_size2x ? 0xFE : 0xFF;
 		
 		if(lcdc & RFlagLCDC::objon) {
 			for(int spr_idx=0; spr_idx<40; spr_idx++) {
 				const std::array<int,4> oamdata = { 
-					mem.m_oam[spr_idx*4 + 0],
-					mem.m_oam[spr_idx*4 + 1],
-					mem.m_oam[spr_idx*4 + 2],
-					mem.m_oam[spr_idx*4 + 3]
+					oam[spr_idx*4 + 0],
+					oam[spr_idx*4 + 1],
+					oam[spr_idx*4 + 2],
+					oam[spr_idx*4 + 3]
 				};
 
 				const int oamdat_tile = oamdata[2] & spr_tilemask;
@@ -406,13 +437,13 @@ namespace fern {
 
 				// get tile address
 				int tileaddr = (attrib_bank * KBSIZE(8)) + (oamdat_tile * 0x10);
-				m_vramMarker.at(tileaddr / 0x10) = attrib_palet + 8;
+				masked_at(m_vramMarker,tileaddr / 0x10) = attrib_palet + 8;
 				if(spr_size2x) {
-					m_vramMarker.at(1 + tileaddr / 0x10) = attrib_palet + 8;
+					masked_at(m_vramMarker,1 + tileaddr / 0x10) = attrib_palet + 8;
 				}
 				tileaddr += line_y * 2;
-				int lineA = mem.m_vram[tileaddr];
-				int lineB = mem.m_vram[tileaddr+1];
+				int lineA = masked_at(vram,tileaddr);
+				int lineB = masked_at(vram,tileaddr+1);
 
 				for(int ix=0; ix<8; ix++) {
 					int x = ix;
@@ -433,8 +464,8 @@ namespace fern {
 
 		// draw window layer ----------------------------@/
 		if(lcdc & RFlagLCDC::winon) {
-			const int bgscroll_x = mem.m_io.m_WX + 7;
-			const int bgscroll_y = mem.m_io.m_WY;
+			const int bgscroll_x = in.wx + 7;
+			const int bgscroll_y = in.wy;
 			
 			if(bgscroll_y <= draw_y && bgscroll_x < fern::SCREEN_X) {
 				const int fetch_y = (draw_y - bgscroll_y) & 0xFF;
@@ -451,19 +482,19 @@ namespace fern {
 					// fetch tile
 					const int mapaddr = addr_mapline + (draw_x/8);
 					const int mapaddr_attrib = mapaddr + KBSIZE(8);
-					const int attrib = mem.m_vram.at(mapaddr_attrib);
+					const int attrib = masked_at(vram,mapaddr_attrib);
 					int attrib_paletnum = attrib & 7;
 					int attrib_banknum = RFlagMapAttrib::bank(attrib);
 
 					int tile = 0;
 					if(lcdc & RFlagLCDC::chr8000) {
-						tile = mem.m_vram.at(mapaddr);
+						tile = masked_at(vram,mapaddr);
 					} else {
-						tile = static_cast<int8_t>(mem.m_vram.at(mapaddr));
+						tile = static_cast<int8_t>(masked_at(vram,mapaddr));
 						tile = (tile + 0x80) & 0xFF;
 					}
 					int tileaddr = (KBSIZE(8) * attrib_banknum) + addr_chrbase + tile * 0x10;
-					m_vramMarker.at(tileaddr / 0x10) = attrib_paletnum;
+					masked_at(m_vramMarker,tileaddr / 0x10) = attrib_paletnum;
 					
 					// get pixel
 					int tileY = (fetch_y&7);
@@ -471,8 +502,8 @@ namespace fern {
 					if(RFlagMapAttrib::flipX(attrib)) tileX = 7-tileX;
 					if(RFlagMapAttrib::flipY(attrib)) tileY = 7-tileY;
 					tileaddr += tileY*2;
-					int lineA = mem.m_vram[tileaddr];
-					int lineB = mem.m_vram[tileaddr+1];
+					int lineA = masked_at(vram,tileaddr);
+					int lineB = masked_at(vram,tileaddr+1);
 					int dotA = (lineA >> (7-tileX)) & 1;
 					int dotB = (lineB >> (7-tileX)) & 1;
 					dot = dotA | (dotB<<1);
@@ -484,19 +515,20 @@ namespace fern {
 			}
 		}
 	}
-	auto CRenderer::draw_lineDMG(int draw_y) -> void {
+	auto CRenderer::draw_lineDMG(int draw_y,const CLineInput& in) -> void {
 		if(draw_y < 0 || draw_y >= 144) return;
 
-		auto& mem = emu()->mem;
+		const auto& vram = *in.vram;
+		const auto& oam = *in.oam;
 		const auto& dmg_palet = fern::CRenderer::MONOPALET_ORANGE;
-		const int lcdc = mem.m_io.m_LCDC;
+		const int lcdc = in.lcdc;
 		std::array<char,fern::SCREEN_X> bg_linebuffer;
 		std::array<char,fern::SCREEN_X> obj_linebuffer;
 		std::array<std::array<int,4>,2> obp_table = {
-			CMem::palet_getLUT(mem.m_io.m_OBP[0]),
-			CMem::palet_getLUT(mem.m_io.m_OBP[1])
+			CMem::palet_getLUT(in.obp[0]),
+			CMem::palet_getLUT(in.obp[1])
 		};
-		std::array<int,4> bgp_table = CMem::palet_getLUT(mem.m_io.m_BGP);
+		std::array<int,4> bgp_table = CMem::palet_getLUT(in.bgp);
 
 		if(!(lcdc & RFlagLCDC::lcdon)) {
 			const auto color = dmg_palet[0];
@@ -508,8 +540,8 @@ namespace fern {
 
 		// draw background ------------------------------@/
 		{
-			const int bgscroll_x = mem.m_io.m_SCX;
-			const int bgscroll_y = mem.m_io.m_SCY;
+			const int bgscroll_x = in.scx;
+			const int bgscroll_y = in.scy;
 			
 			const int fetch_y = (bgscroll_y + draw_y) & 0xFF;
 			size_t addr_chrbase = 0x0800;
@@ -525,18 +557,18 @@ namespace fern {
 					// fetch tile
 					int tile = 0;
 					if(lcdc & RFlagLCDC::chr8000) {
-						tile = mem.m_vram.at(addr_mapline + (fetch_x/8));
+						tile = masked_at(vram,addr_mapline + (fetch_x/8));
 					} else {
-						tile = static_cast<int8_t>(mem.m_vram.at(addr_mapline + (fetch_x/8)));
+						tile = static_cast<int8_t>(masked_at(vram,addr_mapline + (fetch_x/8)));
 						tile = (tile + 0x80) & 0xFF;
 					}
 					int tileaddr = addr_chrbase + tile * 0x10;
-					m_vramMarker.at(tileaddr / 0x10) = 0;
+					masked_at(m_vramMarker,tileaddr / 0x10) = 0;
 
 					// get pixel
 					tileaddr += (fetch_y&7)*2;
-					int lineA = mem.m_vram[tileaddr];
-					int lineB = mem.m_vram[tileaddr+1];
+					int lineA = masked_at(vram,tileaddr);
+					int lineB = masked_at(vram,tileaddr+1);
 					int dotA = (lineA >> (7-(fetch_x&7))) & 1;
 					int dotB = (lineB >> (7-(fetch_x&7))) & 1;
 					dot = dotA | (dotB<<1);
@@ -548,16 +580,16 @@ namespace fern {
 		}
 
 		// draw sprites ---------------------------------@/
-		const bool spr_size2x = (mem.m_io.m_LCDC & 0x04) != 0;
+		const bool spr_size2x = (lcdc & 0x04) != 0;
 		const int spr_height = spr_size2x ? 16 : 8;
 		const int spr_tilemask = spr_size2x ? 0xFE : 0xFF;
 
 		for(int spr_idx=0; spr_idx<40; spr_idx++) {
 			const std::array<int,4> oamdata = { 
-				mem.m_oam[spr_idx*4 + 0],
-				mem.m_oam[spr_idx*4 + 1],
-				mem.m_oam[spr_idx*4 + 2],
-				mem.m_oam[spr_idx*4 + 3]
+				oam[spr_idx*4 + 0],
+				oam[spr_idx*4 + 1],
+				oam[spr_idx*4 + 2],
+				oam[spr_idx*4 + 3]
 			};
 
 			const int oamdat_y = oamdata[0] - 16;
@@ -568,7 +600,7 @@ namespace fern {
 			const bool flipY = (oamdata[3]>>6) & 1;
 			const int oamdat_tile = oamdata[2] & spr_tilemask;
 
-			auto& cur_paltable = obp_table.at(oamdat_palet);
+			auto& cur_paltable = masked_at(obp_table,oamdat_palet);
 			if(oamdat_y <= -16 || oamdat_y >= 144) continue;
 			if(oamdat_x <= -8 || oamdat_x >= fern::SCREEN_X) continue;
 			if(draw_y < oamdat_y) continue;
@@ -581,12 +613,12 @@ namespace fern {
 			// get tile address
 			int tileaddr = 0x0000 + (oamdat_tile * 0x10);
 			tileaddr += line_y * 2;
-			m_vramMarker.at(oamdat_tile) = 1 + oamdat_palet;
+			masked_at(m_vramMarker,oamdat_tile) = 1 + oamdat_palet;
 			if(spr_size2x) {
-				m_vramMarker.at(oamdat_tile + 1) = 1 + oamdat_palet;
+				masked_at(m_vramMarker,oamdat_tile + 1) = 1 + oamdat_palet;
 			}
-			int lineA = mem.m_vram[tileaddr];
-			int lineB = mem.m_vram[tileaddr+1];
+			int lineA = masked_at(vram,tileaddr);
+			int lineB = masked_at(vram,tileaddr+1);
 
 			for(int ix=0; ix<8; ix++) {
 				int x = ix;
@@ -601,14 +633,14 @@ namespace fern {
 				if(oamdat_prio && (bg_linebuffer[oamdat_x+x] > 0)) continue;
 				obj_linebuffer[oamdat_x+x] = dot;
 				m_screen.dot_access(oamdat_x+x,draw_y) = 
-					dmg_palet.at(cur_paltable.at(dot));
+					masked_at(dmg_palet,masked_at(cur_paltable,dot));
 			}
 		}
 
 		// draw window layer ----------------------------@/
 		if(lcdc & RFlagLCDC::winon) {
-			const int bgscroll_x = mem.m_io.m_WX + 7;
-			const int bgscroll_y = mem.m_io.m_WY;
+			const int bgscroll_x = in.wx + 7;
+			const int bgscroll_y = in.wy;
 			
 			if(bgscroll_y <= draw_y && bgscroll_x < fern::SCREEN_X) {
 				const int fetch_y = (draw_y - bgscroll_y) & 0xFF;
@@ -625,18 +657,18 @@ namespace fern {
 					// fetch tile
 					int tile = 0;
 					if(lcdc & RFlagLCDC::chr8000) {
-						tile = mem.m_vram.at(addr_mapline + (draw_x/8));
+						tile = masked_at(vram,addr_mapline + (draw_x/8));
 					} else {
-						tile = static_cast<int8_t>(mem.m_vram.at(addr_mapline + (draw_x/8)));
+						tile = static_cast<int8_t>(masked_at(vram,addr_mapline + (draw_x/8)));
 						tile = (tile + 0x80) & 0xFF;
 					}
 					int tileaddr = addr_chrbase + tile * 0x10;				
-					m_vramMarker.at(tileaddr / 0x10) = 0;
+					masked_at(m_vramMarker,tileaddr / 0x10) = 0;
 
 					// get pixel
 					tileaddr += (fetch_y&7)*2;
-					int lineA = mem.m_vram.at(tileaddr);
-					int lineB = mem.m_vram.at(tileaddr+1);
+					int lineA = masked_at(vram,tileaddr);
+					int lineB = masked_at(vram,tileaddr+1);
 					int dotA = (lineA >> (7-(draw_x&7))) & 1;
 					int dotB = (lineB >> (7-(draw_x&7))) & 1;
 					dot = dotA | (dotB<<1);
@@ -667,14 +699,13 @@ namespace fern {
 		if(y < 0 || y >= height()) return false;
 		return true;
 	}
-	auto CScreen::dot_set(int x, int y, CColor color) -> void {
+	auto CScreen::dot_check(int x, int y) -> void {
 		if(!in_range(x,y)) {
 			std::printf("CScreen::dot_set(): error: invalid coords (%d,%d)\n",
 				x,y
 			);
 			std::exit(-1);
 		}
-		dot_access(x,y) = color;
 	}
 	auto CScreen::clear(fern::CColor color) -> void {
 		for(int i=0; i<dimensions(); i++) {
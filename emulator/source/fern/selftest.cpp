@@ -0,0 +1,287 @@
+#include <fern.h>
+#include <algorithm>
+#include <initializer_list>
+
+// self tests ---------------------------------------------------------------@/
+// run with --selftest, no ROM needed. each test loads a few bytes of code
+// at $0150 of an otherwise empty ROM, and runs it on whichever CPU core
+// this was built with.
+#ifdef FERN_JIT
+namespace {
+	// xorshift32, so the generated programs are the same everywhere
+	struct CSelfTestRng {
+		uint32_t state;
+
+		auto next() -> uint32_t {
+			state ^= state<<13;
+			state ^= state>>17;
+			state ^= state<<5;
+			return state;
+		}
+		auto below(int n) -> int { return next() % n; }
+	};
+	constexpr int SELFTEST_SUB = 0x0800; // the generated subroutine
+	constexpr int SELFTEST_REGS[] = { 0,1,2,3,4,5,7 }; // B,C,D,E,H,L,A
+
+	// one random instruction, or a few that go together. memory accesses
+	// stay in $C000-$C0FF, HRAM and the stack. branches only skip forward
+	// (or call SELFTEST_SUB), so the program always gets back to its loop.
+	auto selftest_genInstr(CSelfTestRng& rng,std::vector<uint8_t>& code,bool branches) -> void {
+		auto reg = [&]() { return SELFTEST_REGS[rng.below(7)]; };
+		auto byte = [&]() { return static_cast<int>(rng.next() & 0xFF); };
+		auto emit = [&](std::initializer_list<int> bytes) {
+			for(int b : bytes) code.push_back(b);
+		};
+		switch(rng.below(branches ? 16 : 12)) {
+			case 0: emit({ 0x40 | reg()<<3 | reg() }); break; // ld r,r'
+			case 1: emit({ 0x80 | rng.below(8)<<3 | reg() }); break; // alu r
+			case 2: emit({ 0xC6 | rng.below(8)<<3,byte() }); break; // alu n
+			case 3: emit({ 0x06 | reg()<<3,byte() }); break; // ld r,n
+			case 4: emit({ 0x04 | reg()<<3 | rng.below(2) }); break; // inc/dec r
+			case 5: { // inc/dec rr, add hl,rr
+				const int ops[] = { 0x03,0x0B,0x09 };
+				emit({ ops[rng.below(3)] | rng.below(3)<<4 });
+				break;
+			}
+			case 6: { // rotates, cpl/scf/ccf, daa
+				const int ops[] = { 0x07,0x0F,0x17,0x1F,0x2F,0x37,0x3F,0x27 };
+				emit({ ops[rng.below(8)] });
+				break;
+			}
+			case 7: emit({ 0xCB,(byte() & 0xF8) | reg() }); break; // CB r
+			case 8: { // through HL
+				emit({ 0x21,byte(),0xC0 });
+				switch(rng.below(7)) {
+					case 0: emit({ 0x46 | reg()<<3 }); break; // ld r,[hl]
+					case 1: emit({ 0x70 | reg() }); break; // ld [hl],r
+					case 2: emit({ 0x36,byte() }); break; // ld [hl],n
+					case 3: emit({ 0x34 | rng.below(2) }); break; // inc/dec [hl]
+					case 4: emit({ 0x86 | rng.below(8)<<3 }); break; // alu [hl]
+					case 5: emit({ 0x22 | rng.below(4)<<3 }); break; // ld [hl+/-],a & back
+					case 6: emit({ 0xCB,(byte() & 0xF8) | 6 }); break; // CB [hl]
+				}
+				break;
+			}
+			case 9: { // through BC or DE
+				const int pair = rng.below(2)<<4;
+				emit({ 0x01 | pair,byte(),0xC0,0x02 | pair | rng.below(2)<<3 });
+				break;
+			}
+			case 10: { // absolute and ldh
+				const int ops[] = { 0xEA,0xFA,0xE0,0xF0 };
+				const int op = ops[rng.below(4)];
+				if(op == 0xEA || op == 0xFA) emit({ op,byte(),0xC0 });
+				else emit({ op,0x80 | (byte() & 0x3F) });
+				break;
+			}
+			case 11: emit({ 0xC5 | rng.below(4)<<4,0xC1 | rng.below(4)<<4 }); break; // push, pop
+			case 12: emit({ 0x20 | rng.below(4)<<3,2,0x06 | reg()<<3,byte() }); break; // jr cc over ld r,n
+			case 13: { // jp cc over ld r,n
+				const int to = 0x150 + code.size() + 5;
+				emit({ 0xC2 | rng.below(4)<<3,to & 0xFF,to>>8,0x06 | reg()<<3,byte() });
+				break;
+			}
+			case 14: emit({ 0xCD,SELFTEST_SUB & 0xFF,SELFTEST_SUB>>8 }); break; // call
+			case 15: emit({ 0xF8,byte() }); break; // ld hl,sp+e
+		}
+	}
+	// a loop of about 300 instructions from $0150, and a subroutine.
+	auto selftest_genProgram(uint32_t seed) -> std::vector<uint8_t> {
+		CSelfTestRng rng { seed };
+		std::vector<uint8_t> code = { 0xF3,0x31,0x00,0xE0 }; // di, ld sp,$E000
+		const int loop = 0x150 + code.size();
+		while(code.size() < 0x400) selftest_genInstr(rng,code,true);
+		code.insert(code.end(),{ 0xC3,static_cast<uint8_t>(loop & 0xFF),static_cast<uint8_t>(loop>>8) });
+		code.resize(SELFTEST_SUB - 0x150);
+		for(int i=0; i<24; i++) selftest_genInstr(rng,code,false);
+		code.push_back(0xC9); // ret
+		return code;
+	}
+
+	struct CSelfTestState {
+		int af,bc,de,hl,sp,pc;
+		bool ime;
+		uint64_t cycles;
+		uint32_t ram; // hash of the memory the program uses
+
+		auto operator==(const CSelfTestState& other) const -> bool {
+			return af == other.af && bc == other.bc && de == other.de && hl == other.hl
+				&& sp == other.sp && pc == other.pc && ime == other.ime
+				&& cycles == other.cycles && ram == other.ram;
+		}
+		auto print(const char* name) const -> void {
+			std::printf("  %-11s AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X PC=%04X IME=%d clock=%llu ram=%08X\n",
+				name,af,bc,de,hl,sp,pc,ime,static_cast<unsigned long long>(cycles),ram
+			);
+		}
+	};
+}
+#endif
+
+namespace fern {
+	auto CEmulator::selftest_run() -> bool {
+		struct SelfTest {
+			const char* name;
+			bool (CEmulator::*fn)();
+		};
+		const SelfTest tests[] = {
+			{ "run: cycles",&CEmulator::selftest_runCycles },
+			{ "run: frame",&CEmulator::selftest_runFrame },
+			{ "watch: write",&CEmulator::selftest_watchWrite },
+			{ "watch: decoded code",&CEmulator::selftest_watchDecode },
+			{ "watch: resume",&CEmulator::selftest_watchResume },
+#ifdef FERN_JIT
+			{ "jit: vs interpreter",&CEmulator::selftest_jit },
+#endif
+		};
+
+		int failed = 0;
+		for(const auto& test : tests) {
+			const bool passed = (this->*test.fn)();
+			std::printf("%-24s %s\n",test.name,passed ? "ok" : "FAILED");
+			if(!passed) failed += 1;
+		}
+		std::printf("%d of %d failed\n",failed,static_cast<int>(std::size(tests)));
+		return failed == 0;
+	}
+	// 2 banks of NOPs, no mapper, DMG.
+	auto CEmulator::selftest_load(const std::vector<uint8_t>& code) -> void {
+		mem.reset();
+		mem.mapper_setupNone();
+		mem.m_rombankCount = 2;
+		mem.m_rombanks[0].data.fill(0);
+		mem.m_rombanks[1].data.fill(0);
+		// reset() leaves RAM as it was, like hardware. tests that run
+		// something twice need it the same both times.
+		mem.m_wram.fill(0);
+		mem.m_hram.fill(0);
+		std::copy(code.begin(),code.end(),mem.m_rombanks[0].data.begin() + 0x150);
+		mem.model_set(false);
+		mem.pages_mapAll();
+
+		cpu.reset();
+		cpu.m_PC = 0x150;
+	}
+
+	// run_cycles() stops once the clock's reached, which nops hit exactly.
+	auto CEmulator::selftest_runCycles() -> bool {
+		selftest_load({});
+		const uint64_t start = cpu.clock_cycles();
+		run_cycles(1000);
+		return cpu.clock_cycles() == start + 1000 && cpu.m_PC == 0x150 + 1000;
+	}
+	// run_frame() stops as vblank starts.
+	auto CEmulator::selftest_runFrame() -> bool {
+		selftest_load({
+			0x18,0xFE // $0150: jr $0150
+		});
+		run_frame();
+		return mem.m_io.m_LY == fern::SCREEN_Y;
+	}
+
+	// a write watchpoint fires on the store, with the value written.
+	auto CEmulator::selftest_watchWrite() -> bool {
+		selftest_load({
+			0x3E,0x5A, // $0150: ld a,$5A
+			0xEA,0x00,0xC0, // $0152: ld [$C000],a
+			0x18,0xFE // $0155: jr $0155
+		});
+		mem.watch_add(-1,0xC000,0xC000,WatchKind::write);
+
+		run_cycles(2); // ld a,$5A
+		if(mem.watch_fired()) return false;
+		run_cycles(4); // ld [$C000],a
+		const auto& hit = mem.watch_hit();
+		return mem.watch_fired() && hit.addr == 0xC000 && hit.new_value == 0x5A;
+	}
+
+	// the cached core decodes a whole block before running any of it. a
+	// read watchpoint on code that's been decoded, but not run or read,
+	// shouldn't fire until something reads it.
+	auto CEmulator::selftest_watchDecode() -> bool {
+		selftest_load({
+			0x00,0x00,0x00,0x00, // $0150: nop x4
+			0xFA,0x58,0x01, // $0154: ld a,[$0158]
+			0x00, // $0157: nop
+			0x18,0xFE // $0158: jr $0158
+		});
+		mem.watch_add(-1,0x0158,0x0159,WatchKind::read);
+
+		run_cycles(2); // nop x2
+		if(mem.watch_fired()) return false;
+		run_cycles(6); // nop x2, ld a,[$0158]
+		return mem.watch_fired() && mem.watch_hit().addr == 0x0158;
+	}
+
+	// a watchpoint can stop the CPU outside run_until() too, like the
+	// debugger's steps. clearing the stop lets it carry on.
+	auto CEmulator::selftest_watchResume() -> bool {
+		selftest_load({
+			0x3E,0x5A, // $0150: ld a,$5A
+			0xEA,0x00,0xC0, // $0152: ld [$C000],a
+			0x00, // $0155: nop
+			0x18,0xFE // $0156: jr $0156
+		});
+		mem.watch_add(-1,0xC000,0xC000,WatchKind::write);
+
+		cpu.run(2);
+		if(!mem.watch_fired() || cpu.m_PC != 0x0155) return false;
+		cpu.break_clearStop();
+		mem.watch_clearFired();
+		cpu.run(1);
+		return cpu.m_PC == 0x0156;
+	}
+
+#ifdef FERN_JIT
+	// compiled blocks against the interpreter. generated programs of mostly
+	// JIT-native instructions run once with the JIT off and once with it
+	// on, in slices of run_cycles(). after each slice the registers, the
+	// clock and the RAM the program uses have to match.
+	auto CEmulator::selftest_jit() -> bool {
+		constexpr int SLICE_COUNT = 200;
+		constexpr int SLICE_CYCLES = 1009; // so the slices end all over the loop
+		auto state_get = [&]() -> CSelfTestState {
+			uint32_t ram = 2166136261u;
+			auto hash = [&](int start,int end) {
+				for(int addr=start; addr<end; addr++) ram = (ram ^ mem.peek(addr)) * 16777619u;
+			};
+			hash(0xC000,0xC100);
+			hash(0xDF00,0xE000);
+			hash(0xFF80,0xFFC0);
+			return {
+				cpu.reg_af(),cpu.reg_bc(),cpu.reg_de(),cpu.reg_hl(),cpu.m_SP,cpu.m_PC,
+				cpu.m_regIME,cpu.clock_cycles(),ram
+			};
+		};
+
+		bool passed = true;
+		for(uint32_t seed=1; seed<=4 && passed; seed++) {
+			const auto code = selftest_genProgram(seed);
+			std::vector<CSelfTestState> expected;
+			cpu.m_jitEnabled = false;
+			selftest_load(code);
+			for(int i=0; i<SLICE_COUNT; i++) {
+				run_cycles(SLICE_CYCLES);
+				expected.push_back(state_get());
+			}
+
+			cpu.m_jitEnabled = true;
+			selftest_load(code);
+			for(int i=0; i<SLICE_COUNT; i++) {
+				run_cycles(SLICE_CYCLES);
+				const auto state = state_get();
+				if(!(state == expected[i])) {
+					std::printf("program %u differs after slice %d:\n",seed,i);
+					state.print("jit");
+					expected[i].print("interpreter");
+					passed = false;
+					break;
+				}
+			}
+			// it has to have compiled something to have tested anything
+			if(cpu.m_jitUsed == 0) passed = false;
+		}
+		return passed;
+	}
+#endif
+}
\ No newline at end of file
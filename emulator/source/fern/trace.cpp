@@ -0,0 +1,160 @@
+#include <fern.h>
+#include <fern_common.h>
+
+// execution trace ----------------------------------------------------------@/
+// trace files are an 8 byte header ("FTR", a version byte, then the record
+// size as a u32), followed by CTraceRecords as they are in memory
+// (little endian).
+// the CPU fills chunks in order; the writer thread writes each one out
+// once it's full, and the last, partial one's written by close().
+namespace {
+	constexpr uint8_t TRACE_VERSION = 1;
+}
+
+namespace fern {
+	CTracer::CTracer() {
+		m_head = 0;
+		m_tail = 0;
+		m_pos = 0;
+		m_recordCount = 0;
+		m_file = nullptr;
+		m_stopping = false;
+	}
+	CTracer::~CTracer() {
+		close();
+	}
+
+	auto CTracer::open(const std::string& filename) -> bool {
+		close();
+		m_file = std::fopen(filename.c_str(),"wb");
+		if(!m_file) return false;
+
+		const uint8_t header[4] = { 'F','T','R',TRACE_VERSION };
+		const uint32_t record_size = sizeof(CTraceRecord);
+		std::fwrite(header,1,sizeof(header),m_file);
+		std::fwrite(&record_size,1,sizeof(record_size),m_file);
+
+		m_ring.resize(CHUNK_COUNT * CHUNK_RECORDS);
+		m_head = 0;
+		m_tail = 0;
+		m_pos = 0;
+		m_recordCount = 0;
+		m_stopping = false;
+		m_thread = std::thread(&CTracer::writer_thread,this);
+		return true;
+	}
+	auto CTracer::close() -> void {
+		if(!m_file) return;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_cond.notify_all();
+		m_thread.join();
+
+		// the writer's done every full chunk, so what's left is the partial one
+		const uint32_t chunk = m_head % CHUNK_COUNT;
+		std::fwrite(&m_ring[chunk*CHUNK_RECORDS],sizeof(CTraceRecord),m_pos,m_file);
+		std::fclose(m_file);
+		m_file = nullptr;
+		m_ring.clear();
+		m_ring.shrink_to_fit();
+	}
+
+	// hands the full chunk to the writer, and waits for the next one to be
+	// free if the writer's fallen a whole ring behind.
+	auto CTracer::chunk_publish() -> void {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_head += 1;
+		m_pos = 0;
+		m_cond.notify_all();
+		m_cond.wait(lock,[&]() { return (m_head - m_tail) < CHUNK_COUNT; });
+	}
+	auto CTracer::writer_thread() -> void {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while(true) {
+			m_cond.wait(lock,[&]() { return m_tail != m_head || m_stopping; });
+			if(m_tail == m_head) break; // stopping, and nothing left
+
+			// chunks from tail to head are the writer's until tail moves
+			const uint32_t chunk = m_tail % CHUNK_COUNT;
+			lock.unlock();
+			std::fwrite(&m_ring[chunk*CHUNK_RECORDS],sizeof(CTraceRecord),CHUNK_RECORDS,m_file);
+			lock.lock();
+			m_tail += 1;
+			m_cond.notify_all();
+		}
+	}
+
+	auto CTracer::dump(const std::string& filename) -> bool {
+		auto file = std::fopen(filename.c_str(),"rb");
+		if(!file) {
+			std::printf("error: unable to open trace '%s'\n",filename.c_str());
+			return false;
+		}
+		uint8_t header[4] = {};
+		uint32_t record_size = 0;
+		std::fread(header,1,sizeof(header),file);
+		std::fread(&record_size,1,sizeof(record_size),file);
+		if(header[0] != 'F' || header[1] != 'T' || header[2] != 'R'
+			|| header[3] != TRACE_VERSION || record_size != sizeof(CTraceRecord)) {
+			std::printf("error: '%s' isn't a trace file (or it's from another version)\n",filename.c_str());
+			std::fclose(file);
+			return false;
+		}
+
+		std::vector<CTraceRecord> records(CHUNK_RECORDS);
+		size_t count = 0;
+		while((count = std::fread(records.data(),sizeof(CTraceRecord),records.size(),file)) > 0) {
+			for(size_t i=0; i<count; i++) {
+				const auto& rec = records[i];
+				std::printf("A:%02X F:%02X B:%02X C:%02X D:%02X E:%02X H:%02X L:%02X SP:%04X PC:%04X PCMEM:%02X,%02X,%02X,%02X\n",
+					rec.af>>8,rec.af & 0xFF,rec.bc>>8,rec.bc & 0xFF,
+					rec.de>>8,rec.de & 0xFF,rec.hl>>8,rec.hl & 0xFF,
+					rec.sp,rec.pc,
+					rec.bytes[0],rec.bytes[1],rec.bytes[2],rec.bytes[3]
+				);
+			}
+		}
+		std::fclose(file);
+		return true;
+	}
+
+#ifdef FERN_TRACE
+	auto CCPU::trace_start(const std::string& filename) -> void {
+		if(!m_tracer.open(filename)) {
+			std::printf("error: unable to open '%s' for tracing\n",filename.c_str());
+			std::exit(-1);
+		}
+		std::printf("tracing to '%s'\n",filename.c_str());
+	}
+	auto CCPU::trace_stop() -> void {
+		if(!m_tracer.is_open()) return;
+		const uint64_t count = m_tracer.record_count();
+		m_tracer.close();
+		std::printf("trace: %llu instructions\n",static_cast<unsigned long long>(count));
+	}
+	auto CCPU::trace_record(int pc) -> void {
+		auto& mem = m_emu->mem;
+		auto& rec = m_tracer.record();
+		rec = {};
+		rec.cycle = m_clockCycles;
+		rec.pc = pc;
+		rec.bank = code_bank(pc);
+		rec.af = reg_af();
+		rec.bc = reg_bc();
+		rec.de = reg_de();
+		rec.hl = reg_hl();
+		rec.sp = m_SP;
+		for(int i=0; i<4; i++) {
+			rec.bytes[i] = mem.peek(pc + i);
+		}
+	}
+#else
+	auto CCPU::trace_start(const std::string& filename) -> void {
+		std::puts("warning: the trace recorder isn't built in (build with TRACE=1)");
+	}
+	auto CCPU::trace_stop() -> void {}
+	auto CCPU::trace_record(int pc) -> void {}
+#endif
+}
@@ -61,6 +61,12 @@ int main(int argc,const char *argv[]) {
 	bool flag_verbose = false;
 	bool flag_debug = false;
 	bool flag_vsync = false;
+	bool flag_bench = false;
+	bool flag_selftest = false;
+	bool flag_profile = false;
+	std::string filename_sym;
+	std::string filename_trace;
+	int gdb_port = 0;
 
 	while(arg_index < argc) {
 		auto arg1 = arg_read();
@@ -78,6 +84,33 @@ int main(int argc,const char *argv[]) {
 		else if(arg1 == "-v") {
 			flag_verbose = true;
 		} 
+		else if(arg1 == "--bench") {
+			flag_bench = true;
+		} 
+		else if(arg1 == "--selftest") {
+			flag_selftest = true;
+		} 
+		else if(arg1 == "--profile") {
+			flag_profile = true;
+		} 
+		else if(arg1 == "--sym") {
+			assert_exit(arg_valid(),"error: --sym needs a filename");
+			filename_sym = arg_read();
+		} 
+		else if(arg1 == "--trace") {
+			assert_exit(arg_valid(),"error: --trace needs a filename");
+			filename_trace = arg_read();
+		} 
+		else if(arg1 == "--tracedump") {
+			assert_exit(arg_valid(),"error: --tracedump needs a filename");
+			const auto filename_dump = arg_read();
+			std::exit(fern::CTracer::dump(filename_dump) ? 0 : -1);
+		} 
+		else if(arg1 == "--gdb") {
+			assert_exit(arg_valid(),"error: --gdb needs a port");
+			gdb_port = std::atoi(arg_read().c_str());
+			assert_exit(gdb_port > 0 && gdb_port < 0x10000,"error: bad --gdb port");
+		} 
 		else {
 			if(!filename_rom.empty()) {
 				std::printf("error: unknown argument '%s'\n",
@@ -89,7 +122,7 @@ int main(int argc,const char *argv[]) {
 		}
 	}
 
-	if(filename_rom.empty()) {
+	if(filename_rom.empty() && !flag_selftest) {
 		const char* filter = "Monochrome GB ROM (*.gb)\0*.gb\0Color GB ROM (*.gbc)\0*.gbc\0All Files (*.*)\0*.*\0\0";
 		std::array<char,512> filename_buf;
 		if(io_promptFileOpen(filename_buf.data(),filename_buf.size(),NULL,filter)) {
@@ -99,15 +132,27 @@ int main(int argc,const char *argv[]) {
 			std::exit(0);
 		}
 	}
-	assert_exit(!filename_rom.empty(),"error: no rom specified");
+	assert_exit(flag_selftest || !filename_rom.empty(),"error: no rom specified");
 
 	fern::CEmuInitFlags flags;
 	flags.debug = flag_debug;
 	flags.vsync = flag_vsync;
 	flags.verbose = flag_verbose;
+	flags.profile = flag_profile;
+	flags.symfile = filename_sym;
+	flags.tracefile = filename_trace;
+	flags.gdbport = gdb_port;
 
 	auto emu = std::make_shared<fern::CEmulator>(&flags);
+	if(flag_selftest) {
+		return emu->selftest_run() ? 0 : -1;
+	}
 	emu->load_romfile(filename_rom);
+	if(flag_bench) {
+		emu->bench_reads();
+		emu->bench_lines();
+		return 0;
+	}
 	emu->boot();
 
 	return 0;
@@ -126,6 +171,13 @@ static void print_usage() {
 		"\t-vs       enable vsync\n"
 		"\t-g        enable debugger\n"
 		"\t-v        verbose flag\n"
+		"\t--bench   time memory reads, then exit\n"
+		"\t--selftest run the built-in tests (no ROM needed), then exit\n"
+		"\t--profile count opcodes & cycles, shown on exit (PROFILE=1 builds)\n"
+		"\t--sym <f> labels for --profile (default: the ROM's .sym)\n"
+		"\t--trace <f>     record an execution trace to f (TRACE=1 builds)\n"
+		"\t--tracedump <f> print trace file f like Gameboy Doctor, then exit\n"
+		"\t--gdb <port>    serve gdb on localhost:port (GDB=1 builds)\n"
 		"\t--help    Display help\n"
 		"\tcontrols:\n"
 		"\t\tarrow keys - d-pad\n"